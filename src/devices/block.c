@@ -1,9 +1,50 @@
 #include "devices/block.h"
 #include <list.h>
+#include <rbtree.h>
+#include <round.h>
 #include <string.h>
 #include <stdio.h>
 #include "devices/ide.h"
+#include "devices/timer.h"
+#include "threads/interrupt.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Maximum number of distinct sectors that the I/O scheduler will
+   merge into a single run of adjacent requests.  Bounding the
+   run length keeps a long sequential stream from starving
+   requests elsewhere on the device. */
+#define BLOCK_MAX_RUN 32
+
+/* Number of buckets in each device's latency histogram.  Bucket
+   0 counts requests that completed within the tick they were
+   issued; bucket I > 0 counts requests that took between
+   2**(I-1) and 2**I - 1 ticks.  The last bucket also counts
+   anything slower. */
+#define BLOCK_LATENCY_BUCKETS 16
+
+/* A request for a single sector, queued on a block device.
+
+   Requests for adjacent sectors in the same direction are merged
+   into a "run", which the device's I/O thread services
+   back-to-back.  Only the head of a run is in the device queue;
+   every member of the run, including the head, is in the head's
+   RUN list in ascending sector order. */
+struct block_request
+  {
+    struct rb_elem queue_elem;          /* Element in block's queue. */
+    struct list_elem run_elem;          /* Element in head's run. */
+    struct list run;                    /* Merged requests (head only). */
+    block_sector_t first, last;         /* Sectors spanned (head only). */
+
+    block_sector_t sector;              /* Sector to transfer. */
+    void *buffer;                       /* BLOCK_SECTOR_SIZE bytes. */
+    bool write;                         /* Write (true) or read (false)? */
+    block_sector_t discard_cnt;         /* Sectors to discard, or 0. */
+    int64_t start;                      /* Tick at which request queued. */
+    struct semaphore done;              /* Up'd when request completes. */
+  };
 
 /* A block device. */
 struct block
@@ -19,8 +60,32 @@ struct block
 
     unsigned long long read_cnt;        /* Number of sectors read. */
     unsigned long long write_cnt;       /* Number of sectors written. */
+    unsigned long long discard_cnt;     /* Number of sectors discarded. */
+
+    /* I/O scheduler. */
+    struct lock queue_lock;             /* Protects the members below. */
+    struct condition queue_ready;       /* Signaled when queue non-empty. */
+    struct rb_tree queue;               /* Runs, ordered by first sector. */
+    block_sector_t head_pos;            /* Sector after last serviced run. */
+    int queue_depth;                    /* Requests queued or in flight. */
+    int max_queue_depth;                /* Highest QUEUE_DEPTH seen. */
+    unsigned long long merge_cnt;       /* Requests merged into a run. */
+    unsigned long long request_cnt;     /* Requests completed. */
+    int64_t latency;                    /* Total ticks spent by requests. */
+
+    /* Access pattern statistics. */
+    unsigned long long histogram[BLOCK_LATENCY_BUCKETS]; /* Latencies. */
+    unsigned long long seq_cnt;         /* Requests following the last. */
+    unsigned long long random_cnt;      /* All other requests. */
+    block_sector_t next_sector;         /* Sector after last request. */
   };
 
+/* Optional trace of all block requests, in a ring buffer.
+   Enabled by block_trace_init(). */
+static struct block_trace_entry *trace;    /* Ring buffer, or null. */
+static size_t trace_size;                  /* Capacity, in entries. */
+static size_t trace_cnt;                   /* Entries ever recorded. */
+
 /* List of all block devices. */
 static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 
@@ -28,6 +93,9 @@ static struct list all_blocks = LIST_INITIALIZER (all_blocks);
 static struct block *block_by_role[BLOCK_ROLE_CNT];
 
 static struct block *list_elem_to_block (struct list_elem *);
+static void submit_request (struct block *, struct block_request *);
+static rb_less_func run_less;
+static thread_func block_io_thread;
 
 /* Returns a human-readable name for the given block device
    TYPE. */
@@ -116,13 +184,22 @@ check_sector (struct block *block, block_sector_t sector)
 /* Reads sector SECTOR from BLOCK into BUFFER, which must
    have room for BLOCK_SECTOR_SIZE bytes.
    Internally synchronizes accesses to block devices, so external
-   per-block device locking is unneeded. */
+   per-block device locking is unneeded.  The request is queued
+   and serviced by BLOCK's I/O thread in elevator order, so
+   concurrent requests may complete in a different order than
+   they were issued. */
 void
 block_read (struct block *block, block_sector_t sector, void *buffer)
 {
+  struct block_request r;
+
   check_sector (block, sector);
-  block->ops->read (block->aux, sector, buffer);
-  block->read_cnt++;
+  r.sector = sector;
+  r.buffer = buffer;
+  r.write = false;
+  r.discard_cnt = 0;
+  submit_request (block, &r);
+  sema_down (&r.done);
 }
 
 /* Write sector SECTOR to BLOCK from BUFFER, which must contain
@@ -133,10 +210,124 @@ block_read (struct block *block, block_sector_t sector, void *buffer)
 void
 block_write (struct block *block, block_sector_t sector, const void *buffer)
 {
+  struct block_request r;
+
+  check_sector (block, sector);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  r.sector = sector;
+  r.buffer = (void *) buffer;
+  r.write = true;
+  r.discard_cnt = 0;
+  submit_request (block, &r);
+  sema_down (&r.done);
+}
+
+/* Tells BLOCK that the CNT sectors starting at SECTOR no longer
+   hold useful data, so that a device that can reclaim the space,
+   such as a RAM disk, may do so.  The sectors' contents are
+   undefined until they are next written.  Does nothing on
+   devices that do not support discarding. */
+void
+block_discard (struct block *block, block_sector_t sector,
+               block_sector_t cnt)
+{
+  struct block_request r;
+
+  if (block->ops->discard == NULL || cnt == 0)
+    return;
+  check_sector (block, sector);
+  check_sector (block, sector + cnt - 1);
+  ASSERT (block->type != BLOCK_FOREIGN);
+  r.sector = sector;
+  r.buffer = NULL;
+  r.write = true;
+  r.discard_cnt = cnt;
+  submit_request (block, &r);
+  sema_down (&r.done);
+}
+
+/* Returns true if BLOCK supports block_discard(). */
+bool
+block_can_discard (struct block *block)
+{
+  return block->ops->discard != NULL;
+}
+
+/* Copies the BLOCK_SECTOR_SIZE bytes at SRC to DST, which must
+   not overlap.  Faster than memcpy() for whole sectors, because
+   the fixed size needs no head or tail handling; best when both
+   buffers are word-aligned, as malloc() and palloc return them. */
+void
+sector_copy (void *dst, const void *src)
+{
+  size_t cnt = BLOCK_SECTOR_SIZE / sizeof (uint32_t);
+
+  asm volatile ("rep movsl"
+                : "+D" (dst), "+S" (src), "+c" (cnt) : : "memory");
+}
+
+/* Starts reading sector SECTOR from BLOCK into BUFFER, which
+   must have room for BLOCK_SECTOR_SIZE bytes, and returns
+   without waiting for the read to finish.  The caller must pass
+   the return value to block_wait() before using BUFFER. */
+struct block_request *
+block_read_async (struct block *block, block_sector_t sector, void *buffer)
+{
+  struct block_request *r;
+
+  check_sector (block, sector);
+  r = malloc (sizeof *r);
+  if (r == NULL)
+    {
+      /* Out of memory: fall back to a synchronous read. */
+      block_read (block, sector, buffer);
+      return NULL;
+    }
+  r->sector = sector;
+  r->buffer = buffer;
+  r->write = false;
+  r->discard_cnt = 0;
+  submit_request (block, r);
+  return r;
+}
+
+/* Starts writing sector SECTOR to BLOCK from BUFFER, which must
+   contain BLOCK_SECTOR_SIZE bytes, and returns without waiting
+   for the write to finish.  The caller must pass the return
+   value to block_wait() before modifying or freeing BUFFER. */
+struct block_request *
+block_write_async (struct block *block, block_sector_t sector,
+                   const void *buffer)
+{
+  struct block_request *r;
+
   check_sector (block, sector);
   ASSERT (block->type != BLOCK_FOREIGN);
-  block->ops->write (block->aux, sector, buffer);
-  block->write_cnt++;
+  r = malloc (sizeof *r);
+  if (r == NULL)
+    {
+      /* Out of memory: fall back to a synchronous write. */
+      block_write (block, sector, buffer);
+      return NULL;
+    }
+  r->sector = sector;
+  r->buffer = (void *) buffer;
+  r->write = true;
+  r->discard_cnt = 0;
+  submit_request (block, r);
+  return r;
+}
+
+/* Waits for request R, returned by block_read_async() or
+   block_write_async(), to complete, and frees it. */
+void
+block_wait (struct block_request *r)
+{
+  if (r != NULL)
+    {
+      sema_down (&r->done);
+      free (r);
+    }
 }
 
 /* Returns the number of sectors in BLOCK. */
@@ -164,20 +355,142 @@ block_type (struct block *block)
 void
 block_print_stats (void)
 {
-  int i;
+  int i, j;
 
   for (i = 0; i < BLOCK_ROLE_CNT; i++)
     {
       struct block *block = block_by_role[i];
       if (block != NULL)
         {
+          int64_t avg = 0;
+
+          if (block->request_cnt > 0)
+            avg = block->latency * 100 / block->request_cnt;
           printf ("%s (%s): %llu reads, %llu writes\n",
                   block->name, block_type_name (block->type),
                   block->read_cnt, block->write_cnt);
+          if (block->discard_cnt > 0)
+            printf ("%s (%s): %llu sectors discarded\n",
+                    block->name, block_type_name (block->type),
+                    block->discard_cnt);
+          printf ("%s (%s): queue depth %d (max %d), %llu merges, "
+                  "%"PRId64".%02"PRId64" ticks average latency\n",
+                  block->name, block_type_name (block->type),
+                  block->queue_depth, block->max_queue_depth,
+                  block->merge_cnt, avg / 100, avg % 100);
+          printf ("%s (%s): %llu sequential, %llu random requests\n",
+                  block->name, block_type_name (block->type),
+                  block->seq_cnt, block->random_cnt);
+          printf ("%s (%s): latency histogram (ticks):",
+                  block->name, block_type_name (block->type));
+          for (j = 0; j < BLOCK_LATENCY_BUCKETS; j++)
+            if (block->histogram[j] != 0)
+              {
+                if (j == 0)
+                  printf (" 0:%llu", block->histogram[j]);
+                else if (j == 1)
+                  printf (" 1:%llu", block->histogram[j]);
+                else if (j == BLOCK_LATENCY_BUCKETS - 1)
+                  printf (" %d+:%llu", 1 << (j - 1), block->histogram[j]);
+                else
+                  printf (" %d-%d:%llu", 1 << (j - 1), (1 << j) - 1,
+                          block->histogram[j]);
+              }
+          printf ("\n");
         }
     }
 }
 
+/* Starts tracing block requests into a ring buffer that holds
+   the most recent ENTRY_CNT requests to any block device. */
+void
+block_trace_init (size_t entry_cnt)
+{
+  ASSERT (trace == NULL);
+  trace = calloc (entry_cnt, sizeof *trace);
+  if (trace == NULL)
+    PANIC ("Failed to allocate memory for block trace");
+  trace_size = entry_cnt;
+}
+
+/* Appends request R on BLOCK to the trace, if tracing is
+   enabled. */
+static void
+trace_request (struct block *block, const struct block_request *r)
+{
+  struct block_trace_entry *e;
+  enum intr_level old_level;
+
+  old_level = intr_disable ();
+  if (trace == NULL)
+    {
+      intr_set_level (old_level);
+      return;
+    }
+  e = &trace[trace_cnt++ % trace_size];
+  e->tick = r->start;
+  e->sector = r->sector;
+  e->tid = thread_tid ();
+  e->type = block->type;
+  e->write = r->write;
+  e->unused = 0;
+  intr_set_level (old_level);
+}
+
+/* Writes the trace to DST, starting at sector 0, oldest entry
+   first.  Sector 0 holds a struct block_trace_header and the
+   entries follow from sector 1.  Tracing is suspended while the
+   trace is written, so the dump does not trace itself. */
+void
+block_trace_dump (struct block *dst)
+{
+  struct block_trace_entry *saved = trace;
+  struct block_trace_header *h;
+  size_t first, cnt, i;
+  uint8_t *buf;
+
+  if (saved == NULL)
+    {
+      printf ("Block tracing is not enabled.\n");
+      return;
+    }
+
+  buf = malloc (BLOCK_SECTOR_SIZE);
+  if (buf == NULL)
+    PANIC ("couldn't allocate buffer");
+  trace = NULL;
+
+  cnt = trace_cnt < trace_size ? trace_cnt : trace_size;
+  first = trace_cnt - cnt;
+  if (1 + DIV_ROUND_UP (cnt, BLOCK_TRACE_PER_SECTOR) > block_size (dst))
+    PANIC ("%s: too small for block trace", block_name (dst));
+
+  printf ("Writing %zu block trace entries to %s...\n",
+          cnt, block_name (dst));
+  memset (buf, 0, BLOCK_SECTOR_SIZE);
+  h = (struct block_trace_header *) buf;
+  h->magic = BLOCK_TRACE_MAGIC;
+  h->entry_cnt = cnt;
+  h->entry_size = sizeof (struct block_trace_entry);
+  h->dropped_cnt = first;
+  block_write (dst, 0, buf);
+
+  for (i = 0; i < cnt; i++)
+    {
+      struct block_trace_entry *e = (struct block_trace_entry *) buf;
+      e[i % BLOCK_TRACE_PER_SECTOR] = saved[(first + i) % trace_size];
+      if (i % BLOCK_TRACE_PER_SECTOR == BLOCK_TRACE_PER_SECTOR - 1
+          || i == cnt - 1)
+        {
+          block_write (dst, 1 + i / BLOCK_TRACE_PER_SECTOR, buf);
+          memset (buf, 0, BLOCK_SECTOR_SIZE);
+        }
+    }
+
+  free (buf);
+  trace = saved;
+}
+
 /* Registers a new block device with the given NAME.  If
    EXTRA_INFO is non-null, it is printed as part of a user
    message.  The block device's SIZE in sectors and its TYPE must
@@ -200,6 +513,20 @@ block_register (const char *name, enum block_type type,
   block->aux = aux;
   block->read_cnt = 0;
   block->write_cnt = 0;
+  block->discard_cnt = 0;
+  lock_init (&block->queue_lock);
+  cond_init (&block->queue_ready);
+  rb_init (&block->queue, run_less, NULL);
+  block->head_pos = 0;
+  block->queue_depth = 0;
+  block->max_queue_depth = 0;
+  block->merge_cnt = 0;
+  block->request_cnt = 0;
+  block->latency = 0;
+  memset (block->histogram, 0, sizeof block->histogram);
+  block->seq_cnt = 0;
+  block->random_cnt = 0;
+  block->next_sector = 0;
 
   printf ("%s: %'"PRDSNu" sectors (", block->name, block->size);
   print_human_readable_size ((uint64_t) block->size * BLOCK_SECTOR_SIZE);
@@ -208,6 +535,10 @@ block_register (const char *name, enum block_type type,
     printf (", %s", extra_info);
   printf ("\n");
 
+  if (thread_create (block->name, PRI_MAX, block_io_thread, block)
+      == TID_ERROR)
+    PANIC ("Failed to start I/O thread for block device %s", block->name);
+
   return block;
 }
 
@@ -221,3 +552,219 @@ list_elem_to_block (struct list_elem *list_elem)
           : NULL);
 }
 
+
+/* Tries to merge request R into a run already queued on BLOCK,
+   which must be locked.  A request merges onto the front or the
+   back of a run in the same direction whose sectors it adjoins.
+   A read also merges into a read run that already covers its
+   sector; the sector is then read from the device only once.
+   Returns true if R was merged, false otherwise. */
+static bool
+merge_request (struct block *block, struct block_request *r)
+{
+  struct block_request key;
+  struct rb_elem *e;
+
+  /* A run spans at most BLOCK_MAX_RUN sectors, so only runs that
+     start between that far below R's sector and just above it
+     can take R. */
+  key.first = r->sector > BLOCK_MAX_RUN ? r->sector - BLOCK_MAX_RUN : 0;
+  for (e = rb_lower_bound (&block->queue, &key.queue_elem);
+       e != rb_end (&block->queue); e = rb_next (e))
+    {
+      struct block_request *h = rb_entry (e, struct block_request,
+                                          queue_elem);
+      bool full = h->last - h->first + 1 >= BLOCK_MAX_RUN;
+
+      if (h->first > r->sector + 1)
+        break;
+      if (h->write != r->write || h->discard_cnt || r->discard_cnt)
+        continue;
+      if (r->sector == h->last + 1 && !full)
+        {
+          /* Back merge. */
+          list_push_back (&h->run, &r->run_elem);
+          h->last = r->sector;
+          return true;
+        }
+      else if (r->sector + 1 == h->first && !full)
+        {
+          /* Front merge.  H moves to its new place in the queue,
+             which may be before other runs that start where it
+             used to. */
+          rb_remove (&block->queue, &h->queue_elem);
+          list_push_front (&h->run, &r->run_elem);
+          h->first = r->sector;
+          rb_insert (&block->queue, &h->queue_elem);
+          return true;
+        }
+      else if (!r->write && r->sector >= h->first && r->sector <= h->last)
+        {
+          /* Duplicate read: place after the other readers of the
+             same sector. */
+          struct list_elem *m = list_begin (&h->run);
+          while (m != list_end (&h->run)
+                 && list_entry (m, struct block_request,
+                                run_elem)->sector <= r->sector)
+            m = list_next (m);
+          list_insert (m, &r->run_elem);
+          return true;
+        }
+    }
+  return false;
+}
+
+/* Returns true if the run headed by A starts before the run
+   headed by B. */
+static bool
+run_less (const struct rb_elem *a_, const struct rb_elem *b_,
+          void *aux UNUSED)
+{
+  const struct block_request *a = rb_entry (a_, struct block_request,
+                                            queue_elem);
+  const struct block_request *b = rb_entry (b_, struct block_request,
+                                            queue_elem);
+  return a->first < b->first;
+}
+
+/* Queues request R on BLOCK, merging it with an adjacent request
+   if possible, and wakes up BLOCK's I/O thread.  R->done is
+   up'd when the request has completed. */
+static void
+submit_request (struct block *block, struct block_request *r)
+{
+  sema_init (&r->done, 0);
+  r->start = timer_ticks ();
+
+  lock_acquire (&block->queue_lock);
+  if (r->sector == block->next_sector || r->sector + 1 == block->next_sector)
+    block->seq_cnt++;
+  else
+    block->random_cnt++;
+  block->next_sector = r->sector + 1;
+  trace_request (block, r);
+  if (merge_request (block, r))
+    block->merge_cnt++;
+  else
+    {
+      list_init (&r->run);
+      list_push_back (&r->run, &r->run_elem);
+      r->first = r->last = r->sector;
+      rb_insert (&block->queue, &r->queue_elem);
+    }
+  if (++block->queue_depth > block->max_queue_depth)
+    block->max_queue_depth = block->queue_depth;
+  cond_signal (&block->queue_ready, &block->queue_lock);
+  lock_release (&block->queue_lock);
+}
+
+/* Removes and returns the next run to service from BLOCK's
+   queue, which must be locked and non-empty.  Runs are serviced
+   in C-LOOK order: the head sweeps toward higher sectors, then
+   jumps back to the lowest queued sector. */
+static struct block_request *
+next_run (struct block *block)
+{
+  struct block_request key;
+  struct rb_elem *e;
+
+  ASSERT (!rb_empty (&block->queue));
+  key.first = block->head_pos;
+  e = rb_lower_bound (&block->queue, &key.queue_elem);
+  if (e == rb_end (&block->queue))
+    e = rb_begin (&block->queue);
+  rb_remove (&block->queue, e);
+  return rb_entry (e, struct block_request, queue_elem);
+}
+
+/* Performs every request in the run headed by H on BLOCK, in
+   ascending sector order. */
+static void
+do_run (struct block *block, struct block_request *h)
+{
+  struct block_request *prev = NULL;
+  struct list_elem *e;
+
+  for (e = list_begin (&h->run); e != list_end (&h->run); e = list_next (e))
+    {
+      struct block_request *r = list_entry (e, struct block_request,
+                                            run_elem);
+      if (r->discard_cnt > 0)
+        {
+          block->ops->discard (block->aux, r->sector, r->discard_cnt);
+          block->discard_cnt += r->discard_cnt;
+        }
+      else if (r->write)
+        {
+          block->ops->write (block->aux, r->sector, r->buffer);
+          block->write_cnt++;
+        }
+      else if (prev != NULL && prev->sector == r->sector)
+        sector_copy (r->buffer, prev->buffer);
+      else
+        {
+          block->ops->read (block->aux, r->sector, r->buffer);
+          block->read_cnt++;
+        }
+      prev = r;
+    }
+}
+
+/* Returns the latency histogram bucket for a request that took
+   TICKS timer ticks. */
+static int
+latency_bucket (int64_t ticks)
+{
+  int bucket = 0;
+
+  while (ticks > 0 && bucket < BLOCK_LATENCY_BUCKETS - 1)
+    {
+      ticks >>= 1;
+      bucket++;
+    }
+  return bucket;
+}
+
+/* I/O thread for the block device passed as BLOCK_.  Services
+   the runs queued on the device one at a time and wakes up the
+   threads waiting on them. */
+static void
+block_io_thread (void *block_)
+{
+  struct block *block = block_;
+
+  for (;;)
+    {
+      struct block_request *h;
+      struct list_elem *e, *next;
+      int64_t now;
+
+      lock_acquire (&block->queue_lock);
+      while (rb_empty (&block->queue))
+        cond_wait (&block->queue_ready, &block->queue_lock);
+      h = next_run (block);
+      lock_release (&block->queue_lock);
+
+      do_run (block, h);
+
+      /* Each request may be deallocated as soon as it is
+         signaled, so H, which holds the run list, goes last. */
+      now = timer_ticks ();
+      lock_acquire (&block->queue_lock);
+      block->head_pos = h->last + 1;
+      for (e = list_begin (&h->run); e != list_end (&h->run); e = next)
+        {
+          struct block_request *r = list_entry (e, struct block_request,
+                                                run_elem);
+          next = list_next (e);
+          block->queue_depth--;
+          block->request_cnt++;
+          block->latency += now - r->start;
+          block->histogram[latency_bucket (now - r->start)]++;
+          if (r != h)
+            sema_up (&r->done);
+        }
+      sema_up (&h->done);
+      lock_release (&block->queue_lock);
+    }
+}
@@ -1,6 +1,7 @@
 #ifndef DEVICES_BLOCK_H
 #define DEVICES_BLOCK_H
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <inttypes.h>
 
@@ -53,11 +54,69 @@ struct block *block_next (struct block *);
 block_sector_t block_size (struct block *);
 void block_read (struct block *, block_sector_t, void *);
 void block_write (struct block *, block_sector_t, const void *);
+void block_discard (struct block *, block_sector_t, block_sector_t cnt);
+bool block_can_discard (struct block *);
 const char *block_name (struct block *);
 enum block_type block_type (struct block *);
 
+/* Sector buffers. */
+void sector_copy (void *dst, const void *src);
+
+/* Asynchronous block device operations.
+   Each call queues a request and returns without waiting for it;
+   the caller must pass the result to block_wait() exactly once
+   and must not touch the buffer until then.  Requests to
+   different devices proceed in parallel.
+
+   Requests to the same device, including those made by
+   block_read() and block_write(), are serviced in C-LOOK order,
+   not the order they were made in.  A request that overlaps a
+   sector of one still pending may therefore be serviced before
+   it: a block_read() of a sector just passed to
+   block_write_async() can return the sector's old contents.
+   Callers must block_wait() for a request before making another
+   that touches any of the same sectors. */
+struct block_request;
+struct block_request *block_read_async (struct block *, block_sector_t,
+                                        void *);
+struct block_request *block_write_async (struct block *, block_sector_t,
+                                         const void *);
+void block_wait (struct block_request *);
+
 /* Statistics. */
 void block_print_stats (void);
+
+/* Request tracing.
+
+   When enabled, every block request is recorded in a ring buffer
+   that can be dumped to a block device for offline analysis.
+   The dump starts with a header sector, followed by the entries
+   packed BLOCK_TRACE_PER_SECTOR to a sector, oldest first. */
+#define BLOCK_TRACE_MAGIC 0x43525442    /* "BTRC", little-endian. */
+
+struct block_trace_header
+  {
+    uint32_t magic;             /* BLOCK_TRACE_MAGIC. */
+    uint32_t entry_cnt;         /* Number of entries that follow. */
+    uint32_t entry_size;        /* sizeof (struct block_trace_entry). */
+    uint32_t dropped_cnt;       /* Older entries overwritten in the ring. */
+  };
+
+struct block_trace_entry
+  {
+    uint32_t tick;              /* Timer tick when the request was issued. */
+    block_sector_t sector;      /* Sector within the device. */
+    int32_t tid;                /* Thread that issued the request. */
+    uint8_t type;               /* enum block_type of the device. */
+    uint8_t write;              /* 1 for a write, 0 for a read. */
+    uint16_t unused;
+  };
+
+#define BLOCK_TRACE_PER_SECTOR \
+        (BLOCK_SECTOR_SIZE / sizeof (struct block_trace_entry))
+
+void block_trace_init (size_t entry_cnt);
+void block_trace_dump (struct block *);
 
 /* Lower-level interface to block device drivers. */
 
@@ -65,6 +124,10 @@ struct block_operations
   {
     void (*read) (void *aux, block_sector_t, void *buffer);
     void (*write) (void *aux, block_sector_t, const void *buffer);
+
+    /* Optional: reclaims CNT sectors starting at the given one.
+       A null pointer means the device ignores discards. */
+    void (*discard) (void *aux, block_sector_t, block_sector_t cnt);
   };
 
 struct block *block_register (const char *name, enum block_type,
@@ -60,7 +60,12 @@ struct ata_disk
   };
 
 /* An ATA channel (aka controller).
-   Each channel can control up to two disks. */
+   Each channel can control up to two disks.  A legacy channel
+   can only execute one command at a time, so the master and the
+   slave take turns through LOCK, but the two channels operate
+   independently: each block device has its own request queue
+   and I/O thread (see devices/block.c), so a request to hda can
+   be in flight at the same time as one to hdc or hdd. */
 struct channel
   {
     char name[8];               /* Name, e.g. "ide0". */
@@ -379,7 +384,8 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    NULL                        /* No discard support. */
   };
 
 /* Selects device D, waiting for it to become ready, and then
@@ -1,16 +1,21 @@
 #include "devices/input.h"
 #include <debug.h>
+#include <stdio.h>
 #include "devices/intq.h"
 #include "devices/serial.h"
 
 /* Stores keys from the keyboard and serial port. */
 static struct intq buffer;
 
-/* Initializes the input buffer. */
+/* Initializes the input buffer to hold up to SIZE bytes.  If
+   that much memory can't be allocated, falls back to the default
+   INTQ_BUFSIZE. */
 void
-input_init (void) 
+input_init (size_t size) 
 {
   intq_init (&buffer);
+  if (size > INTQ_BUFSIZE && !intq_resize (&buffer, size))
+    printf ("input: can't allocate %zu-byte buffer\n", size);
 }
 
 /* Adds a key to the input buffer.
@@ -41,6 +46,24 @@ input_getc (void)
   return key;
 }
 
+/* Retrieves up to CNT keys from the input buffer into KEYS and
+   returns the number retrieved.  If the buffer is empty,
+   waits for a key to be pressed, then retrieves every key that
+   is available. */
+size_t
+input_getbuf (void *keys, size_t cnt) 
+{
+  enum intr_level old_level;
+  size_t key_cnt;
+
+  old_level = intr_disable ();
+  key_cnt = intq_getbuf (&buffer, keys, cnt);
+  serial_notify ();
+  intr_set_level (old_level);
+
+  return key_cnt;
+}
+
 /* Returns true if the input buffer is full,
    false otherwise.
    Interrupts must be off. */
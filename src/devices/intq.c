@@ -1,8 +1,11 @@
 #include "devices/intq.h"
 #include <debug.h>
+#include <string.h>
+#include "threads/malloc.h"
 #include "threads/thread.h"
 
-static int next (int pos);
+static size_t next (const struct intq *q, size_t pos);
+static size_t used (const struct intq *q);
 static void wait (struct intq *q, struct thread **waiter);
 static void signal (struct intq *q, struct thread **waiter);
 
@@ -12,9 +15,53 @@ intq_init (struct intq *q)
 {
   lock_init (&q->lock);
   q->not_full = q->not_empty = NULL;
+  q->buf = q->init_buf;
+  q->size = sizeof q->init_buf;
   q->head = q->tail = 0;
 }
 
+/* Gives Q a buffer of SIZE bytes, preserving the bytes already
+   in Q.  Must be called from a kernel thread, not an interrupt
+   handler, because it allocates memory.  Returns true if
+   successful, false if memory could not be allocated or Q holds
+   more bytes than the new buffer could. */
+bool
+intq_resize (struct intq *q, size_t size) 
+{
+  enum intr_level old_level;
+  uint8_t *new_buf, *old_buf;
+  size_t cnt;
+
+  ASSERT (!intr_context ());
+  ASSERT (size >= 2);
+
+  new_buf = malloc (size);
+  if (new_buf == NULL)
+    return false;
+
+  old_level = intr_disable ();
+  cnt = used (q);
+  if (cnt >= size) 
+    {
+      intr_set_level (old_level);
+      free (new_buf);
+      return false;
+    }
+  intq_getbuf (q, new_buf, cnt);
+  old_buf = q->buf;
+  q->buf = new_buf;
+  q->size = size;
+  q->tail = 0;
+  q->head = cnt;
+  if (!intq_full (q))
+    signal (q, &q->not_full);
+  intr_set_level (old_level);
+
+  if (old_buf != q->init_buf)
+    free (old_buf);
+  return true;
+}
+
 /* Returns true if Q is empty, false otherwise. */
 bool
 intq_empty (const struct intq *q) 
@@ -28,7 +75,7 @@ bool
 intq_full (const struct intq *q) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  return next (q->head) == q->tail;
+  return next (q, q->head) == q->tail;
 }
 
 /* Removes a byte from Q and returns it.
@@ -49,11 +96,51 @@ intq_getc (struct intq *q)
     }
   
   byte = q->buf[q->tail];
-  q->tail = next (q->tail);
+  q->tail = next (q, q->tail);
   signal (q, &q->not_full);
   return byte;
 }
 
+/* Removes up to CNT bytes from Q, storing them in BUFFER, and
+   returns the number of bytes removed.  If Q is empty and CNT is
+   nonzero, sleeps until at least one byte is added, then removes
+   as many bytes as are available, so that a reader is woken once
+   for a burst of input rather than once per byte.
+   When called from an interrupt handler, Q must not be empty. */
+size_t
+intq_getbuf (struct intq *q, void *buffer, size_t cnt) 
+{
+  uint8_t *dst = buffer;
+  size_t copied = 0;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+  if (cnt == 0)
+    return 0;
+  while (intq_empty (q)) 
+    {
+      ASSERT (!intr_context ());
+      lock_acquire (&q->lock);
+      wait (q, &q->not_empty);
+      lock_release (&q->lock);
+    }
+
+  /* Copy in at most two chunks, one up to the end of the buffer
+     and one from its start. */
+  while (copied < cnt && !intq_empty (q)) 
+    {
+      size_t end = q->head >= q->tail ? q->head : q->size;
+      size_t chunk = end - q->tail;
+
+      if (chunk > cnt - copied)
+        chunk = cnt - copied;
+      memcpy (dst + copied, q->buf + q->tail, chunk);
+      copied += chunk;
+      q->tail = (q->tail + chunk) % q->size;
+    }
+  signal (q, &q->not_full);
+  return copied;
+}
+
 /* Adds BYTE to the end of Q.
    If Q is full, sleeps until a byte is removed.
    When called from an interrupt handler, Q must not be full. */
@@ -70,15 +157,22 @@ intq_putc (struct intq *q, uint8_t byte)
     }
 
   q->buf[q->head] = byte;
-  q->head = next (q->head);
+  q->head = next (q, q->head);
   signal (q, &q->not_empty);
 }
 
-/* Returns the position after POS within an intq. */
-static int
-next (int pos) 
+/* Returns the position after POS within Q. */
+static size_t
+next (const struct intq *q, size_t pos) 
+{
+  return (pos + 1) % q->size;
+}
+
+/* Returns the number of bytes in Q. */
+static size_t
+used (const struct intq *q) 
 {
-  return (pos + 1) % INTQ_BUFSIZE;
+  return (q->head + q->size - q->tail) % q->size;
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
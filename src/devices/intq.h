@@ -1,6 +1,7 @@
 #ifndef DEVICES_INTQ_H
 #define DEVICES_INTQ_H
 
+#include <stddef.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
 
@@ -8,8 +9,8 @@
    kernel threads and external interrupt handlers.
 
    Interrupt queue functions can be called from kernel threads or
-   from external interrupt handlers.  Except for intq_init(),
-   interrupts must be off in either case.
+   from external interrupt handlers.  Except for intq_init() and
+   intq_resize(), interrupts must be off in either case.
 
    The interrupt queue has the structure of a "monitor".  Locks
    and condition variables from threads/synch.h cannot be used in
@@ -17,7 +18,8 @@
    protect kernel threads from one another, not from interrupt
    handlers. */
 
-/* Queue buffer size, in bytes. */
+/* Initial queue buffer size, in bytes.  A queue can be given a
+   larger buffer later with intq_resize(). */
 #define INTQ_BUFSIZE 64
 
 /* A circular queue of bytes. */
@@ -29,15 +31,19 @@ struct intq
     struct thread *not_empty;   /* Thread waiting for not-empty condition. */
 
     /* Queue. */
-    uint8_t buf[INTQ_BUFSIZE];  /* Buffer. */
-    int head;                   /* New data is written here. */
-    int tail;                   /* Old data is read here. */
+    uint8_t *buf;               /* Buffer, either INIT_BUF or malloc()'d. */
+    size_t size;                /* Size of BUF, in bytes. */
+    size_t head;                /* New data is written here. */
+    size_t tail;                /* Old data is read here. */
+    uint8_t init_buf[INTQ_BUFSIZE];  /* Initial buffer. */
   };
 
 void intq_init (struct intq *);
+bool intq_resize (struct intq *, size_t size);
 bool intq_empty (const struct intq *);
 bool intq_full (const struct intq *);
 uint8_t intq_getc (struct intq *);
+size_t intq_getbuf (struct intq *, void *, size_t);
 void intq_putc (struct intq *, uint8_t);
 
 #endif /* devices/intq.h */
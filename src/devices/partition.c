@@ -14,6 +14,7 @@ struct partition
   };
 
 static struct block_operations partition_operations;
+static struct block_operations partition_discard_operations;
 
 static void read_partition_table (struct block *, block_sector_t sector,
                                   block_sector_t primary_extended_sector,
@@ -181,7 +182,11 @@ found_partition (struct block *block, uint8_t part_type,
       snprintf (name, sizeof name, "%s%d", block_name (block), part_nr);
       snprintf (extra_info, sizeof extra_info, "%s (%02x)",
                 partition_type_name (part_type), part_type);
-      block_register (name, type, extra_info, size, &partition_operations, p);
+      block_register (name, type, extra_info, size,
+                      (block_can_discard (block)
+                       ? &partition_discard_operations
+                       : &partition_operations),
+                      p);
     }
 }
 
@@ -320,5 +325,23 @@ partition_write (void *p_, block_sector_t sector, const void *buffer)
 static struct block_operations partition_operations =
   {
     partition_read,
-    partition_write
+    partition_write,
+    NULL                        /* No discard support. */
+  };
+
+/* Discards the CNT sectors starting at SECTOR in partition P. */
+static void
+partition_discard (void *p_, block_sector_t sector, block_sector_t cnt)
+{
+  struct partition *p = p_;
+  block_discard (p->block, p->start + sector, cnt);
+}
+
+/* Operations for a partition of a device that supports
+   discarding sectors. */
+static struct block_operations partition_discard_operations =
+  {
+    partition_read,
+    partition_write,
+    partition_discard
   };
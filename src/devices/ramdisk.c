@@ -0,0 +1,105 @@
+#include "devices/ramdisk.h"
+#include <debug.h>
+#include <round.h>
+#include <string.h>
+#include "devices/block.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/vaddr.h"
+
+/* The code in this file implements a block device backed by
+   memory, for benchmarking file system code without the cost of
+   emulated disk I/O and for scratch data that need not outlive
+   the machine.
+
+   Pages are taken from the user pool when the RAM disk is
+   created, all at once, so that user processes, which draw on the
+   same pool, can't use them up and leave a write with nowhere to
+   go.  A RAM disk bigger than the user pool is refused at boot.
+   The block layer services each device from a single I/O thread,
+   so no further locking is needed here. */
+
+/* Number of sectors that fit in a page. */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
+
+/* A RAM disk. */
+struct ramdisk
+  {
+    size_t page_cnt;            /* Number of pages spanned. */
+    uint8_t **pages;            /* Backing pages. */
+  };
+
+static struct block_operations ramdisk_operations;
+
+/* Creates a RAM disk KB kilobytes in size and registers it with
+   the block device layer as "ram0".  It is registered as a raw
+   device, so it takes a role only when named explicitly, e.g.
+   with -filesys=ram0. */
+void
+ramdisk_init (size_t kb)
+{
+  block_sector_t size = kb * 1024 / BLOCK_SECTOR_SIZE;
+  struct ramdisk *rd;
+  size_t i;
+
+  if (size == 0)
+    return;
+
+  rd = malloc (sizeof *rd);
+  if (rd == NULL)
+    PANIC ("Failed to allocate memory for RAM disk descriptor");
+  rd->page_cnt = DIV_ROUND_UP (size, SECTORS_PER_PAGE);
+  rd->pages = calloc (rd->page_cnt, sizeof *rd->pages);
+  if (rd->pages == NULL)
+    PANIC ("Failed to allocate memory for RAM disk page table");
+  for (i = 0; i < rd->page_cnt; i++)
+    {
+      rd->pages[i] = palloc_get_page (PAL_USER | PAL_ZERO);
+      if (rd->pages[i] == NULL)
+        PANIC ("RAM disk of %zu kB does not fit in user pool", kb);
+    }
+
+  block_register ("ram0", BLOCK_RAW, "RAM disk", size,
+                  &ramdisk_operations, rd);
+}
+
+/* Returns the address of SECTOR in RD's memory. */
+static uint8_t *
+sector_addr (struct ramdisk *rd, block_sector_t sector)
+{
+  return (rd->pages[sector / SECTORS_PER_PAGE]
+          + sector % SECTORS_PER_PAGE * BLOCK_SECTOR_SIZE);
+}
+
+/* Reads sector SECTOR from RAM disk RD into BUFFER, which must
+   have room for BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_read (void *rd, block_sector_t sector, void *buffer)
+{
+  memcpy (buffer, sector_addr (rd, sector), BLOCK_SECTOR_SIZE);
+}
+
+/* Writes sector SECTOR to RAM disk RD from BUFFER, which must
+   contain BLOCK_SECTOR_SIZE bytes. */
+static void
+ramdisk_write (void *rd, block_sector_t sector, const void *buffer)
+{
+  memcpy (sector_addr (rd, sector), buffer, BLOCK_SECTOR_SIZE);
+}
+
+/* Discards the CNT sectors starting at SECTOR in RAM disk RD.
+   The pages stay reserved, but the sectors are zeroed, so that
+   every discarded sector reads back as zeros. */
+static void
+ramdisk_discard (void *rd, block_sector_t sector, block_sector_t cnt)
+{
+  for (; cnt > 0; sector++, cnt--)
+    memset (sector_addr (rd, sector), 0, BLOCK_SECTOR_SIZE);
+}
+
+static struct block_operations ramdisk_operations =
+  {
+    ramdisk_read,
+    ramdisk_write,
+    ramdisk_discard
+  };
@@ -33,6 +33,18 @@
 #define MCR_REG (IO_BASE + 4)   /* MODEM Control Register. */
 #define LSR_REG (IO_BASE + 5)   /* Line Status Register (read-only). */
 
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+#define FCR_CLEAR_RECV 0x02     /* Clear receive FIFO. */
+#define FCR_CLEAR_XMIT 0x04     /* Clear transmit FIFO. */
+
+/* Size of the transmit queue once interrupt-driven I/O is set
+   up, in bytes. */
+#define TXQ_SIZE 1024
+
+/* Depth of the 16550A transmit FIFO, in bytes. */
+#define XMIT_FIFO_SIZE 16
+
 /* Interrupt Enable Register bits. */
 #define IER_RECV 0x01           /* Interrupt when data received. */
 #define IER_XMIT 0x02           /* Interrupt when transmit finishes. */
@@ -88,6 +100,17 @@ serial_init_queue (void)
   ASSERT (mode == POLL);
 
   intr_register_ext (0x20 + 4, serial_interrupt, "serial");
+
+  /* Give the transmit queue room for a few lines of output, now
+     that malloc() works, so that writers sleep less often
+     waiting for the port. */
+  intq_resize (&txq, TXQ_SIZE);
+
+  /* Enable the FIFOs, so that each transmit interrupt can hand
+     the UART up to XMIT_FIFO_SIZE bytes instead of just one.
+     The receive trigger level stays at 1 byte, so input is
+     still delivered as soon as it arrives. */
+  outb (FCR_REG, FCR_ENABLE | FCR_CLEAR_RECV | FCR_CLEAR_XMIT);
   mode = QUEUE;
   old_level = intr_disable ();
   write_ier ();
@@ -98,31 +121,54 @@ serial_init_queue (void)
 void
 serial_putc (uint8_t byte) 
 {
+  serial_write (&byte, 1);
+}
+
+/* Sends the N bytes in BUFFER to the serial port.
+   Interrupts are disabled only once for the whole buffer, rather
+   than once per byte. */
+void
+serial_write (const void *buffer, size_t n) 
+{
+  const uint8_t *p = buffer;
   enum intr_level old_level = intr_disable ();
 
   if (mode != QUEUE)
     {
       /* If we're not set up for interrupt-driven I/O yet,
-         use dumb polling to transmit a byte. */
+         use dumb polling to transmit the bytes. */
       if (mode == UNINIT)
         init_poll ();
-      putc_poll (byte); 
+      while (n-- > 0)
+        putc_poll (*p++); 
     }
   else 
     {
-      /* Otherwise, queue a byte and update the interrupt enable
-         register. */
-      if (old_level == INTR_OFF && intq_full (&txq)) 
+      /* Otherwise, queue the bytes and update the interrupt
+         enable register. */
+      while (n-- > 0) 
         {
-          /* Interrupts are off and the transmit queue is full.
-             If we wanted to wait for the queue to empty,
-             we'd have to reenable interrupts.
-             That's impolite, so we'll send a character via
-             polling instead. */
-          putc_poll (intq_getc (&txq)); 
+          if (intq_full (&txq)) 
+            {
+              if (old_level == INTR_OFF) 
+                {
+                  /* Interrupts are off and the transmit queue is
+                     full.  If we wanted to wait for the queue to
+                     empty, we'd have to reenable interrupts.
+                     That's impolite, so we'll send a character
+                     via polling instead. */
+                  putc_poll (intq_getc (&txq)); 
+                }
+              else
+                {
+                  /* intq_putc() will sleep until the interrupt
+                     handler makes room, so make sure the
+                     transmit interrupt is enabled first. */
+                  write_ier (); 
+                }
+            }
+          intq_putc (&txq, *p++); 
         }
-
-      intq_putc (&txq, byte); 
       write_ier ();
     }
   
@@ -218,10 +264,16 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If the transmit FIFO has drained, refill it with as many
+     bytes as it holds.  THRE stays clear until the FIFO is empty
+     again, so it can't be polled between bytes. */
+  if ((inb (LSR_REG) & LSR_THRE) != 0) 
+    {
+      int i;
+
+      for (i = 0; i < XMIT_FIFO_SIZE && !intq_empty (&txq); i++)
+        outb (THR_REG, intq_getc (&txq));
+    }
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
@@ -9,6 +9,7 @@
  */
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <syscall.h>
 
 /* You should define DIM to be large enough that the arrays
@@ -28,15 +29,20 @@
  16,384 3,145,728 kB */
 #define DIM 128
 
-int A[DIM][DIM];
-int B[DIM][DIM];
-int C[DIM][DIM];
-
 int
 main (void)
 {
+  int (*A)[DIM] = malloc (DIM * sizeof *A);
+  int (*B)[DIM] = malloc (DIM * sizeof *B);
+  int (*C)[DIM] = malloc (DIM * sizeof *C);
   int i, j, k;
 
+  if (A == NULL || B == NULL || C == NULL)
+    {
+      printf ("matmult: out of memory\n");
+      exit (-1);
+    }
+
   /* Initialize the matrices. */
   for (i = 0; i < DIM; i++)
     for (j = 0; j < DIM; j++)
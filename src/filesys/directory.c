@@ -253,11 +253,162 @@ dir_remove (struct dir *dir, const char *name)
   return success;
 }
 
+/* Number of directory entries remove_contents() reads at a
+   time, about a sector's worth. */
+#define REMOVE_CHUNK (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+/* Returns the offset just past the entry for the inode in SECTOR
+   in directory INODE, or the end of INODE if it has none. */
+static off_t
+entry_after (struct inode *inode, block_sector_t sector)
+{
+  struct dir_entry e;
+  off_t ofs;
+
+  for (ofs = sizeof e; inode_read_at (inode, &e, sizeof e, ofs) == sizeof e;
+       ofs += sizeof e)
+    if (e.in_use && e.inode_sector == sector)
+      return ofs + sizeof e;
+  return ofs;
+}
+
+/* Removes everything in the directory TOP, descending into
+   subdirectories.  The directory itself must already be
+   unreachable, so its entries are left as they are rather than
+   being erased one at a time: they go away with the directory.
+
+   A user can make the tree as deep as it likes, so this doesn't
+   recurse.  Once a subdirectory is empty, we remove it and go
+   back up to the parent recorded in its first entry, then find
+   our place in the parent again.  Directories on the way down
+   stay open, so reopening one on the way back up can't fail. */
+static void
+remove_contents (struct inode *top)
+{
+  struct dir_entry one, *entries;
+  size_t chunk = REMOVE_CHUNK;
+  struct inode *inode = top;
+  off_t ofs = sizeof (struct dir_entry);
+
+  /* Fall back to reading one entry at a time if memory is short,
+     since the directory is already unlinked and must not be left
+     half removed. */
+  entries = malloc (chunk * sizeof *entries);
+  if (entries == NULL)
+    {
+      entries = &one;
+      chunk = 1;
+    }
+
+  for (;;)
+    {
+      off_t size = inode_read_at (inode, entries, chunk * sizeof *entries,
+                                  ofs);
+      size_t i, cnt = size / sizeof *entries;
+      struct inode *subdir = NULL;
+
+      /* Remove files until we come to a subdirectory. */
+      for (i = 0; i < cnt && subdir == NULL; i++)
+        if (entries[i].in_use)
+          {
+            struct inode *child = inode_open (entries[i].inode_sector);
+            if (child == NULL)
+              continue;
+            if (inode_is_dir (child))
+              subdir = child;
+            else
+              {
+                inode_remove (child);
+                inode_close (child);
+              }
+          }
+      ofs += i * sizeof *entries;
+
+      if (subdir != NULL)
+        {
+          /* Descend, leaving INODE open. */
+          inode = subdir;
+          ofs = sizeof (struct dir_entry);
+        }
+      else if (cnt < chunk)
+        {
+          /* INODE is empty now. */
+          struct dir_entry parent_entry;
+          block_sector_t sector = inode_get_inumber (inode);
+          struct inode *parent;
+
+          if (inode == top)
+            break;
+          inode_read_at (inode, &parent_entry, sizeof parent_entry, 0);
+          parent = inode_open (parent_entry.inode_sector);
+          ASSERT (parent != NULL);
+          inode_close (parent);
+
+          inode_remove (inode);
+          inode_close (inode);
+          inode = parent;
+          ofs = entry_after (inode, sector);
+        }
+    }
+
+  if (entries != &one)
+    free (entries);
+}
+
+/* Removes any entry for NAME in DIR and, if it is a directory,
+   everything below it.  The entry is erased first, in the same
+   journal operation as the rest of the removal, so that a crash
+   partway through can only leak sectors, not leave entries that
+   point to freed inodes.  Returns true if successful, false on
+   failure. */
+bool
+dir_remove_tree (struct dir *dir, const char *name)
+{
+  struct dir_entry e;
+  struct inode *inode;
+  off_t ofs;
+
+  ASSERT (dir != NULL);
+  ASSERT (name != NULL);
+
+  if (!lookup (dir, name, &e, &ofs))
+    return false;
+  inode = inode_open (e.inode_sector);
+  if (inode == NULL)
+    return false;
+
+  e.in_use = false;
+  if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+    {
+      inode_close (inode);
+      return false;
+    }
+  if (inode_is_dir (inode))
+    remove_contents (inode);
+  inode_remove (inode);
+  inode_close (inode);
+  return true;
+}
+
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
    contains no more entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
+{
+  struct inode *inode;
+  bool success = dir_readdir_inode (dir, name, &inode);
+
+  inode_close (inode);
+  return success;
+}
+
+/* Like dir_readdir(), but also opens the entry's inode and stores
+   it in *INODE, or a null pointer if it cannot be opened.  The
+   caller must close *INODE. */
+bool
+dir_readdir_inode (struct dir *dir, char name[NAME_MAX + 1],
+                   struct inode **inode)
 {
   struct dir_entry e;
 
@@ -267,9 +418,11 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
+          *inode = inode_open (e.inode_sector);
           return true;
         } 
     }
+  *inode = NULL;
   return false;
 }
 
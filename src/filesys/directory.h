@@ -33,7 +33,10 @@ struct inode *dir_get_inode (struct dir *);
 bool dir_lookup (const struct dir *, const char *name, struct inode **);
 bool dir_add (struct dir *, const char *name, block_sector_t);
 bool dir_remove (struct dir *, const char *name);
+bool dir_remove_tree (struct dir *, const char *name);
 bool dir_readdir (struct dir *, char name[NAME_MAX + 1]);
+bool dir_readdir_inode (struct dir *, char name[NAME_MAX + 1],
+                        struct inode **);
 bool dir_is_empty (struct dir *);
 
 #endif /* filesys/directory.h */
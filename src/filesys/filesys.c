@@ -7,6 +7,7 @@
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
 #include "filesys/directory.h"
+#include "filesys/journal.h"
 #include "threads/thread.h"
 #include "threads/malloc.h"
 
@@ -30,6 +31,7 @@ filesys_init (bool format)
   if (format) 
     do_format ();
 
+  journal_open ();
   free_map_open ();
 }
 
@@ -39,6 +41,7 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  journal_close ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE. Returns true if successful, false otherwise.
@@ -52,13 +55,17 @@ filesys_create (const char *name, off_t initial_size)
   block_sector_t inode_sector = 0;
   struct dir *dir = get_dir (name, false);
   char *filename = get_filename (name);
+  /* Place the inode in its directory's allocation group. */
+  block_sector_t goal = dir != NULL ? inode_get_inumber (dir_get_inode (dir)) : 0;
+  journal_begin ();
   bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
+                  && free_map_allocate_near (1, goal, &inode_sector)
                   && inode_create (inode_sector, initial_size, false)
                   && dir_add (dir, filename, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
+  journal_end ();
 
   return success;
 }
@@ -105,8 +112,28 @@ filesys_remove (const char *name)
 {
   struct dir *dir = get_dir (name, false);
   char *filename = get_filename (name);
+  journal_begin ();
   bool success = dir != NULL && dir_remove (dir, filename);
   dir_close (dir); 
+  journal_end ();
+
+  return success;
+}
+
+/* Deletes the file or directory named NAME and, if it is a
+   directory, everything in it.
+   Returns true if successful, false on failure.
+   Fails if no file named NAME exists,
+   or if an internal memory allocation fails. */
+bool
+filesys_remove_tree (const char *name)
+{
+  struct dir *dir = get_dir (name, false);
+  char *filename = get_filename (name);
+  journal_begin ();
+  bool success = dir != NULL && dir_remove_tree (dir, filename);
+  dir_close (dir);
+  journal_end ();
 
   return success;
 }
@@ -119,6 +146,7 @@ do_format (void)
   free_map_create ();
   if (!dir_create (ROOT_DIR_SECTOR, 16, NULL))
     PANIC ("root directory creation failed");
+  journal_create ();
   free_map_close ();
   printf ("done.\n");
 }
@@ -7,6 +7,7 @@
 /* Sectors of system file inodes. */
 #define FREE_MAP_SECTOR 0       /* Free map file inode sector. */
 #define ROOT_DIR_SECTOR 1       /* Root directory file inode sector. */
+#define JOURNAL_SECTOR 2        /* Journal superblock sector. */
 
 /* Block device that contains the file system. */
 struct block *fs_device;
@@ -16,6 +17,7 @@ void filesys_done (void);
 bool filesys_create (const char *name, off_t initial_size);
 struct file *filesys_open (const char *name);
 bool filesys_remove (const char *name);
+bool filesys_remove_tree (const char *name);
 struct dir *get_dir (const char *path, bool include_last_token);
 char *get_filename (const char *paht);
 
@@ -1,13 +1,45 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
+/* Bits of the free map held by each sector of the free map file.
+   The file is written a sector at a time, as bits change, and a
+   sector that has never been written is a hole in the file, which
+   reads back as zeros, that is, as free sectors.  Formatting thus
+   writes only the part of the free map that is in use. */
+#define SECTOR_BITS (BLOCK_SECTOR_SIZE * 8)
+
+/* True while write_bits() is writing the free map file.  Writing
+   into a hole in the file allocates a sector, which changes the
+   free map again; that nested change is only recorded in the
+   range below, to be written once the outer write finishes. */
+static bool writing;
+static size_t dirty_start, dirty_end;   /* Bits changed meanwhile. */
+
+/* Extents of at least this many sectors start on a multiple of
+   this many sectors.  Sector numbers here are relative to the
+   start of the file system partition, so an aligned extent
+   covers whole pages of a RAM disk or whole clusters of a host
+   image, which can then be reclaimed when the extent is freed
+   and discarded. */
+#define FREE_MAP_ALIGN 8
+
+/* The disk is divided into allocation groups of this many
+   sectors.  Allocations start looking for free space at a goal
+   sector and move on to later groups only when its group is
+   full, so that a file's inode sits near its directory and its
+   data near its inode.  New directories instead go to the group
+   with the most free space, to leave room for their files. */
+#define FREE_MAP_GROUP_SIZE 1024
+
 /* Initializes the free map. */
 void
 free_map_init (void) 
@@ -17,6 +49,105 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+  bitmap_mark (free_map, JOURNAL_SECTOR);
+}
+
+/* Returns the first sector of a run of CNT free sectors at or
+   after START, or BITMAP_ERROR if there is no such run.  If CNT
+   is at least FREE_MAP_ALIGN, prefers a run aligned to that many
+   sectors, but only one that starts in START's allocation group;
+   an aligned run further away is not worth passing up a nearer
+   one for. */
+static size_t
+scan_from (size_t start, size_t cnt)
+{
+  size_t pos = start;
+
+  if (cnt >= FREE_MAP_ALIGN)
+    {
+      size_t end = ROUND_UP (start + 1, FREE_MAP_GROUP_SIZE);
+
+      while (pos < end)
+        {
+          size_t sector = bitmap_scan (free_map, pos, cnt, false);
+          if (sector == BITMAP_ERROR || sector >= end)
+            break;
+          if (sector % FREE_MAP_ALIGN == 0)
+            return sector;
+          pos = ROUND_UP (sector, FREE_MAP_ALIGN);
+        }
+    }
+  return bitmap_scan (free_map, start, cnt, false);
+}
+
+/* Returns the first sector of a run of CNT free sectors, looking
+   first at GOAL and after it, then wrapping around to the start
+   of the disk, or BITMAP_ERROR if there is no such run. */
+static size_t
+scan_near (block_sector_t goal, size_t cnt)
+{
+  size_t sector = BITMAP_ERROR;
+
+  if (goal < bitmap_size (free_map))
+    sector = scan_from (goal, cnt);
+  if (sector == BITMAP_ERROR && goal > 0)
+    sector = scan_from (0, cnt);
+  return sector;
+}
+
+/* Writes the sectors of the free map file that hold the CNT bits
+   starting at START.  Returns true if successful, false if the
+   free map file could not be written. */
+static bool
+write_bits (size_t start, size_t cnt)
+{
+  size_t end = start + cnt;
+  bool success = true;
+
+  if (free_map_file == NULL || cnt == 0)
+    return true;
+  if (writing)
+    {
+      if (dirty_start == dirty_end)
+        dirty_start = start, dirty_end = end;
+      dirty_start = start < dirty_start ? start : dirty_start;
+      dirty_end = end > dirty_end ? end : dirty_end;
+      return true;
+    }
+
+  writing = true;
+  dirty_start = dirty_end = 0;
+  for (;;)
+    {
+      start = ROUND_DOWN (start, SECTOR_BITS);
+      end = ROUND_UP (end, SECTOR_BITS);
+      if (end > bitmap_size (free_map))
+        end = bitmap_size (free_map);
+      if (!bitmap_write_part (free_map, free_map_file, start, end - start))
+        success = false;
+      if (dirty_start == dirty_end)
+        break;
+      start = dirty_start;
+      end = dirty_end;
+      dirty_start = dirty_end = 0;
+    }
+  writing = false;
+  return success;
+}
+
+/* Marks the CNT sectors starting at SECTOR as in use and writes
+   the free map.  Returns false, leaving the sectors free, if the
+   free map file could not be written. */
+static bool
+claim (block_sector_t sector, size_t cnt)
+{
+  bitmap_set_multiple (free_map, sector, cnt, true);
+  if (!write_bits (sector, cnt))
+    {
+      bitmap_set_multiple (free_map, sector, cnt, false);
+      return false;
+    }
+  return true;
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
@@ -27,17 +158,74 @@ free_map_init (void)
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  return free_map_allocate_near (cnt, 0, sectorp);
+}
+
+/* Like free_map_allocate(), but prefers sectors at or just after
+   GOAL. */
+bool
+free_map_allocate_near (size_t cnt, block_sector_t goal,
+                        block_sector_t *sectorp)
+{
+  block_sector_t sector = scan_near (goal, cnt);
+  if (sector == BITMAP_ERROR || !claim (sector, cnt))
+    return false;
+  *sectorp = sector;
+  return true;
+}
+
+/* Allocates the CNT sectors starting at SECTOR.  Returns true if
+   successful, false if any of them is already in use or if the
+   free_map file could not be written. */
+bool
+free_map_allocate_at (block_sector_t sector, size_t cnt)
+{
+  if (sector + cnt > bitmap_size (free_map)
+      || bitmap_any (free_map, sector, cnt))
+    return false;
+  return claim (sector, cnt);
+}
+
+/* Finds CNT consecutive free sectors, choosing them as
+   free_map_allocate_near() would, and stores the first into
+   *SECTORP without allocating them.  Returns true if successful,
+   false if not enough consecutive sectors are free. */
+bool
+free_map_find (size_t cnt, block_sector_t goal, block_sector_t *sectorp)
+{
+  block_sector_t sector = scan_near (goal, cnt);
+  if (sector == BITMAP_ERROR)
+    return false;
+  *sectorp = sector;
+  return true;
+}
+
+/* Returns a goal sector for a new directory whose parent's inode
+   is at sector PARENT: the start of the allocation group with the
+   most free sectors, preferring the groups after PARENT's so that
+   sibling directories spread out evenly. */
+block_sector_t
+free_map_dir_goal (block_sector_t parent)
+{
+  size_t sectors = bitmap_size (free_map);
+  size_t group_cnt = DIV_ROUND_UP (sectors, FREE_MAP_GROUP_SIZE);
+  size_t best = 0, best_free = 0;
+  size_t i;
+
+  for (i = 1; i <= group_cnt; i++)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      size_t group = (parent / FREE_MAP_GROUP_SIZE + i) % group_cnt;
+      size_t start = group * FREE_MAP_GROUP_SIZE;
+      size_t cnt = sectors - start < FREE_MAP_GROUP_SIZE
+                   ? sectors - start : FREE_MAP_GROUP_SIZE;
+      size_t free_cnt = bitmap_count (free_map, start, cnt, false);
+      if (free_cnt > best_free)
+        {
+          best = start;
+          best_free = free_cnt;
+        }
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-  return sector != BITMAP_ERROR;
+  return best;
 }
 
 /* Makes CNT sectors starting at SECTOR available for use. */
@@ -46,7 +234,8 @@ free_map_release (block_sector_t sector, size_t cnt)
 {
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  write_bits (sector, cnt);
+  journal_revoke (sector, cnt);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -68,10 +257,14 @@ free_map_close (void)
 }
 
 /* Creates a new free map file on disk and writes the free map to
-   it. */
+   it.  Only the sectors of the file that record sectors in use
+   are written; the rest of the file is left as holes, so this
+   takes the same time however large the disk is. */
 void
 free_map_create (void) 
 {
+  size_t start;
+
   /* Create inode. */
   if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
     PANIC ("free map creation failed");
@@ -80,6 +273,12 @@ free_map_create (void)
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
-  if (!bitmap_write (free_map, free_map_file))
-    PANIC ("can't write free map");
+  for (start = 0; start < bitmap_size (free_map); start += SECTOR_BITS)
+    {
+      size_t cnt = bitmap_size (free_map) - start;
+      if (cnt > SECTOR_BITS)
+        cnt = SECTOR_BITS;
+      if (bitmap_any (free_map, start, cnt) && !write_bits (start, cnt))
+        PANIC ("can't write free map");
+    }
 }
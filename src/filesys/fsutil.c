@@ -7,6 +7,7 @@
 #include "filesys/directory.h"
 #include "filesys/file.h"
 #include "filesys/filesys.h"
+#include "filesys/inode.h"
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/vaddr.h"
@@ -28,6 +29,134 @@ fsutil_ls (char **argv UNUSED)
   printf ("End of listing.\n");
 }
 
+/* Maximum length of a path printed by walk_files(). */
+#define PATH_MAX 128
+
+/* Called by walk_files() for each file, with its full PATH. */
+typedef void walk_func (const char *path, struct inode *, void *aux);
+
+/* Calls FUNC for each regular file in DIR and, recursively, in its
+   subdirectories.  PATH, a buffer of PATH_MAX bytes, holds the
+   name of DIR. */
+static void
+walk_files (struct dir *dir, char *path, walk_func *func, void *aux)
+{
+  size_t len = strlen (path);
+  char name[NAME_MAX + 1];
+
+  while (dir_readdir (dir, name))
+    {
+      struct inode *inode;
+
+      if (!dir_lookup (dir, name, &inode))
+        continue;
+      snprintf (path + len, PATH_MAX - len, "/%s", name);
+      if (inode_is_dir (inode))
+        {
+          struct dir *subdir = dir_open (inode);
+          if (subdir != NULL)
+            {
+              walk_files (subdir, path, func, aux);
+              dir_close (subdir);
+            }
+        }
+      else
+        {
+          func (path, inode, aux);
+          inode_close (inode);
+        }
+      path[len] = '\0';
+    }
+}
+
+/* Calls FUNC for each regular file in the file system. */
+static void
+walk_all_files (walk_func *func, void *aux)
+{
+  struct dir *dir;
+  char *path;
+
+  path = malloc (PATH_MAX);
+  dir = dir_open_root ();
+  if (path == NULL || dir == NULL)
+    PANIC ("couldn't open root directory");
+  path[0] = '\0';
+  walk_files (dir, path, func, aux);
+  dir_close (dir);
+  free (path);
+}
+
+/* Totals for the frag and defrag actions. */
+struct frag_totals
+  {
+    int files;                  /* Files examined. */
+    int fragmented;             /* Files in more than one run. */
+    size_t fragments;           /* Runs, over all files. */
+  };
+
+/* walk_func for fsutil_frag(). */
+static void
+report_fragments (const char *path, struct inode *inode, void *totals_)
+{
+  struct frag_totals *totals = totals_;
+  size_t sectors;
+  size_t fragments = inode_fragments (inode, &sectors);
+
+  printf ("%s: %zu fragment(s) in %zu sector(s)\n",
+          path, fragments, sectors);
+  totals->files++;
+  totals->fragments += fragments;
+  if (fragments > 1)
+    totals->fragmented++;
+}
+
+/* Prints the number of runs of consecutive sectors that each file
+   is stored in. */
+void
+fsutil_frag (char **argv UNUSED)
+{
+  struct frag_totals totals = {0, 0, 0};
+
+  printf ("Fragmentation report:\n");
+  walk_all_files (report_fragments, &totals);
+  printf ("%d file(s), %d fragmented, %zu fragment(s) in all.\n",
+          totals.files, totals.fragmented, totals.fragments);
+}
+
+/* walk_func for fsutil_defrag(). */
+static void
+defrag_file (const char *path, struct inode *inode, void *totals_)
+{
+  struct frag_totals *totals = totals_;
+  size_t sectors;
+  size_t before = inode_fragments (inode, &sectors);
+
+  totals->files++;
+  if (before <= 1)
+    return;
+  if (!inode_defrag (inode))
+    printf ("%s: not enough contiguous free space\n", path);
+  else
+    {
+      size_t after = inode_fragments (inode, &sectors);
+      printf ("%s: %zu -> %zu fragment(s)\n", path, before, after);
+      totals->fragmented++;
+    }
+}
+
+/* Moves each fragmented file's data into one run of consecutive
+   sectors. */
+void
+fsutil_defrag (char **argv UNUSED)
+{
+  struct frag_totals totals = {0, 0, 0};
+
+  printf ("Defragmenting file system...\n");
+  walk_all_files (defrag_file, &totals);
+  printf ("Defragmented %d of %d file(s).\n",
+          totals.fragmented, totals.files);
+}
+
 /* Prints the contents of file ARGV[1] to the system console as
    hex and ASCII. */
 void
@@ -75,12 +204,13 @@ fsutil_extract (char **argv UNUSED)
   static block_sector_t sector = 0;
 
   struct block *src;
-  void *header, *data;
+  void *header, *data, *next_data;
 
   /* Allocate buffers. */
   header = malloc (BLOCK_SECTOR_SIZE);
   data = malloc (BLOCK_SECTOR_SIZE);
-  if (header == NULL || data == NULL)
+  next_data = malloc (BLOCK_SECTOR_SIZE);
+  if (header == NULL || data == NULL || next_data == NULL)
     PANIC ("couldn't allocate buffers");
 
   /* Open source block device. */
@@ -96,6 +226,7 @@ fsutil_extract (char **argv UNUSED)
       const char *file_name;
       const char *error;
       enum ustar_type type;
+      struct block_request *req;
       int size;
 
       /* Read and parse ustar header. */
@@ -124,13 +255,27 @@ fsutil_extract (char **argv UNUSED)
           if (dst == NULL)
             PANIC ("%s: open failed", file_name);
 
-          /* Do copy. */
+          /* Do copy.  The scratch and file system devices are
+             usually on different IDE channels, so read the next
+             sector from the scratch device while the current one
+             is being written to the file system. */
+          req = size > 0 ? block_read_async (src, sector, next_data) : NULL;
           while (size > 0)
             {
               int chunk_size = (size > BLOCK_SECTOR_SIZE
                                 ? BLOCK_SECTOR_SIZE
                                 : size);
-              block_read (src, sector++, data);
+              void *tmp;
+
+              block_wait (req);
+              sector++;
+              tmp = data;
+              data = next_data;
+              next_data = tmp;
+              req = (size > chunk_size
+                     ? block_read_async (src, sector, next_data)
+                     : NULL);
+
               if (file_write (dst, data, chunk_size) != chunk_size)
                 PANIC ("%s: write failed with %d bytes unwritten",
                        file_name, size);
@@ -151,6 +296,7 @@ fsutil_extract (char **argv UNUSED)
   block_write (src, 0, header);
   block_write (src, 1, header);
 
+  free (next_data);
   free (data);
   free (header);
 }
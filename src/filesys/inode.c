@@ -5,75 +5,121 @@
 #include <string.h>
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
+#include "filesys/journal.h"
 #include "threads/malloc.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
-off_t dinode_extend (struct inode_disk *dinode, off_t new_length);
-void dinode_free (struct inode_disk *dinode);
+/* Sector number stored in the block map for a data sector or
+   index block that has not been allocated, a "hole".  Holes read
+   back as zeros.  Sector 0 holds the free map inode, so it is
+   never a data sector or index block. */
+#define HOLE 0
+
+/* Maximum number of data sectors in an inode. */
+#define INODE_MAX_SECTORS (DIR_BLOCKS + INDIR_BLOCKS * INDIR_BLOCK_PTRS \
+                           + DINDIR_BLOCKS * INDIR_BLOCK_PTRS * INDIR_BLOCK_PTRS)
 
 struct indir_block 
 {
   block_sector_t ptr[INDIR_BLOCK_PTRS];
 };
 
-/* Returns the number of total data sectors to allocate for an inode SIZE bytes long. */
-static inline size_t
-bytes_to_total_sectors (off_t size)
+/* Returns true if INODE's data is file system metadata, which is
+   written through the journal, false if it is ordinary file data,
+   which is written in place. */
+static inline bool
+is_metadata (const struct inode *inode)
 {
-  return DIV_ROUND_UP (size, BLOCK_SECTOR_SIZE);
+  return inode->isdir || inode->sector == FREE_MAP_SECTOR;
 }
 
-/* Returns the block device sector that contains byte offset POS within INODE.
-   Returns -1 if INODE does not contain data for a byte at offset POS. */
-static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+/* Reads data SECTOR of INODE into BUFFER. */
+static void
+read_sector (const struct inode *inode, block_sector_t sector, void *buffer)
 {
-  ASSERT (inode != NULL);
-  if (pos < inode->data.length && pos >= 0) 
-  {
-    if (pos < BLOCK_SECTOR_SIZE * DIR_BLOCKS)
-    {
-      return inode->data.direct[pos / BLOCK_SECTOR_SIZE];
-    }
-    /* Single indirect */
-    else if (pos < BLOCK_SECTOR_SIZE * (DIR_BLOCKS + INDIR_BLOCK_PTRS * INDIR_BLOCKS)) 
-    {
-      pos -= BLOCK_SECTOR_SIZE * DIR_BLOCKS; 
-      uint32_t indir_idx = pos / (BLOCK_SECTOR_SIZE * INDIR_BLOCK_PTRS);
-      uint32_t indir_block[INDIR_BLOCK_PTRS];
+  if (is_metadata (inode))
+    journal_read (sector, buffer);
+  else
+    block_read (fs_device, sector, buffer);
+}
 
-      /* Fetch indirect block contents */
-      block_read (fs_device, inode->data.indirect[indir_idx], &indir_block);
+/* Writes BUFFER to data SECTOR of INODE. */
+static void
+write_sector (const struct inode *inode, block_sector_t sector,
+              const void *buffer)
+{
+  if (is_metadata (inode))
+    journal_write (sector, buffer);
+  else
+    block_write (fs_device, sector, buffer);
+}
 
-      pos %= BLOCK_SECTOR_SIZE * INDIR_BLOCK_PTRS; /* Offset within a block */ 
-      return indir_block[pos / BLOCK_SECTOR_SIZE];
-    }
-    /* Double indirect */
-    else 
-    {
-      /* Fetch double indirect block contents */
-      pos -= BLOCK_SECTOR_SIZE * (DIR_BLOCKS + INDIR_BLOCK_PTRS * INDIR_BLOCKS); 
-      uint32_t indir_idx = pos / (BLOCK_SECTOR_SIZE * INDIR_BLOCK_PTRS * INDIR_BLOCK_PTRS);
-      uint32_t indir_block[INDIR_BLOCK_PTRS];
+/* Finds the block map entry for data sector IDX in MAP.
+   Returns a pointer to the entry in MAP that leads to it and
+   stores the indexes to follow through each level of index
+   blocks below that entry in PATH[].  Returns the number of
+   levels, from 0 for a direct block to 2 for a doubly indirect
+   one. */
+static int
+map_path (struct block_map *map, size_t idx, block_sector_t **rootp,
+          size_t path[2])
+{
+  ASSERT (idx < INODE_MAX_SECTORS);
 
-      if (indir_idx < DINDIR_BLOCKS) block_read (fs_device, inode->data.dindirect[indir_idx], &indir_block);
-      else return -1; /* Exceeded maximum file size. */
+  if (idx < DIR_BLOCKS)
+    {
+      *rootp = &map->direct[idx];
+      return 0;
+    }
+  idx -= DIR_BLOCKS;
 
-      pos %= BLOCK_SECTOR_SIZE * INDIR_BLOCK_PTRS * INDIR_BLOCK_PTRS;
-      
-      /* Fetch indirect block contents */
-      indir_idx = pos / (BLOCK_SECTOR_SIZE * INDIR_BLOCK_PTRS);
-      uint32_t indir_ptr = indir_block[indir_idx];
+  /* Single indirect */
+  if (idx < INDIR_BLOCKS * INDIR_BLOCK_PTRS)
+    {
+      *rootp = &map->indirect[idx / INDIR_BLOCK_PTRS];
+      path[0] = idx % INDIR_BLOCK_PTRS;
+      return 1;
+    }
+  idx -= INDIR_BLOCKS * INDIR_BLOCK_PTRS;
 
-      block_read (fs_device, indir_ptr, &indir_block);
+  /* Double indirect */
+  *rootp = &map->dindirect[idx / (INDIR_BLOCK_PTRS * INDIR_BLOCK_PTRS)];
+  path[0] = idx / INDIR_BLOCK_PTRS % INDIR_BLOCK_PTRS;
+  path[1] = idx % INDIR_BLOCK_PTRS;
+  return 2;
+}
 
-      pos %= BLOCK_SECTOR_SIZE * INDIR_BLOCK_PTRS; 
-      return indir_block[pos / BLOCK_SECTOR_SIZE];
+/* Returns the block device sector that holds data sector IDX in
+   MAP, or HOLE if that sector has not been allocated. */
+static block_sector_t
+lookup_sector (const struct block_map *map, size_t idx)
+{
+  struct indir_block block;
+  block_sector_t *root, sector;
+  size_t path[2];
+  int depth, i;
+
+  depth = map_path ((struct block_map *) map, idx, &root, path);
+  sector = *root;
+  for (i = 0; i < depth && sector != HOLE; i++)
+    {
+      journal_read (sector, &block);
+      sector = block.ptr[path[i]];
     }
-  }
-  else return -1;
+  return sector;
+}
+
+/* Returns the block device sector that contains byte offset POS within INODE,
+   or HOLE if no sector has been allocated for it yet. */
+static block_sector_t
+byte_to_sector (const struct inode *inode, off_t pos) 
+{
+  ASSERT (inode != NULL);
+  ASSERT (!inode->inlined);
+  ASSERT (pos >= 0 && pos < inode->length);
+  return lookup_sector (&inode->map, pos / BLOCK_SECTOR_SIZE);
 }
 
 /* List of open inodes, so that opening a single inode twice
@@ -87,181 +133,184 @@ inode_init (void)
   list_init (&open_inodes);
 }
 
-/* Returns actual new length of the inode. It may differ from the given new_length if an error occurs. */
-off_t dinode_extend (struct inode_disk *dinode, off_t new_length)
-{
-  static char zeros[BLOCK_SECTOR_SIZE] = {0}; 
-  size_t new_data_sectors = bytes_to_total_sectors(new_length) - bytes_to_total_sectors(dinode->length);
-
-  /* Contraction is not allowed.*/
-  ASSERT (new_data_sectors >= 0);
-
-  /* Extension in the same sector only modifies dinode->length information */
-  if (new_data_sectors == 0) goto done; 
-
-  /* Extension to direct block */
-  while (dinode->dir_cnt < DIR_BLOCKS)
+/* Data sectors being handed out by inode_write_at(). */
+struct data_run
   {
-    dinode->dir_cnt++;
-    free_map_allocate (1, &dinode->direct[dinode->dir_cnt-1]);
-    block_write(fs_device, dinode->direct[dinode->dir_cnt-1], zeros);
-    new_data_sectors--;
-    if (new_data_sectors == 0) goto done;
-  }
-
-  /* Extension to single indirect block */
-  while (dinode->indir_cnt < INDIR_BLOCKS)
-  {
-    struct indir_block block; 
-
-    /* No indirect block exists or current indirect block is full. */
-    if (dinode->indir_cnt == 0 || dinode->indir_curr_usage == INDIR_BLOCK_PTRS)
+    block_sector_t next;        /* Next free sector in current run. */
+    size_t left;                /* Sectors left in current run. */
+    block_sector_t goal;        /* Where to look for the next run. */
+  };
+
+/* Allocates a data sector from RUN into *SECTORP.  If RUN is
+   used up, allocates up to WANTED sectors, the number the caller
+   may still need, as one contiguous run near RUN's goal, falling
+   back to shorter runs as the free map fragments.  Returns false
+   if the disk is full. */
+static bool
+alloc_data_sector (struct data_run *run, size_t wanted,
+                   block_sector_t *sectorp)
+{
+  if (run->left == 0)
     {
-      dinode->indir_cnt++;
-      free_map_allocate(1, &dinode->indirect[dinode->indir_cnt-1]);
-      dinode->indir_curr_usage = 0;
-    }
-    
-    block_read(fs_device, dinode->indirect[dinode->indir_cnt-1], &block);
+      size_t cnt;
 
-    while (dinode->indir_curr_usage < INDIR_BLOCK_PTRS)
-    {
-      dinode->indir_curr_usage++;
-      free_map_allocate(1, &block.ptr[dinode->indir_curr_usage-1]);
-      block_write(fs_device, block.ptr[dinode->indir_curr_usage-1], zeros);
-      new_data_sectors--;
-      if (new_data_sectors == 0) break;
+      for (cnt = wanted; cnt > 1; cnt /= 2)
+        if (free_map_allocate_near (cnt, run->goal, &run->next))
+          break;
+      if (cnt <= 1)
+        {
+          cnt = 1;
+          if (!free_map_allocate_near (1, run->goal, &run->next))
+            return false;
+        }
+      run->left = cnt;
+      run->goal = run->next + cnt;
     }
+  *sectorp = run->next++;
+  run->left--;
+  return true;
+}
 
-    block_write(fs_device, dinode->indirect[dinode->indir_cnt-1], &block);
-    if (new_data_sectors == 0) goto done;
-  }
-
-  /* Extension to double indirect block */
-  while (dinode->dindir_cnt < DINDIR_BLOCKS)
-  {
-    struct indir_block d_block, block;
-
-    /* No double indirect block exists or current block is full. */
-    if (dinode->dindir_cnt == 0 || dinode->dindir_curr_usage == INDIR_BLOCK_PTRS)
+/* Stores in *SECTORP the block device sector that holds data
+   sector IDX in MAP, first allocating it, and any index blocks
+   leading to it, if it is a hole.  Data sectors come from RUN,
+   as described for alloc_data_sector().  New index blocks are
+   written through the journal; if an entry in MAP itself
+   changes, sets *MAP_CHANGED to true.  Sets *FRESH to true if
+   the data sector was just allocated, so that its contents are
+   garbage, false if it holds file data.  Returns false if the
+   disk is full. */
+static bool
+allocate_sector (struct block_map *map, size_t idx,
+                 struct data_run *run, size_t wanted,
+                 block_sector_t *sectorp, bool *fresh, bool *map_changed)
+{
+  struct indir_block block;
+  block_sector_t *slot, parent = HOLE;
+  size_t path[2];
+  int depth, level;
+
+  depth = map_path (map, idx, &slot, path);
+  *fresh = false;
+  for (level = 0; ; level++)
     {
-      dinode->dindir_cnt++;
-      free_map_allocate(1, &dinode->dindirect[dinode->dindir_cnt-1]);
-      dinode->dindir_curr_usage = 0;
-    }
-    
-    block_read(fs_device, dinode->dindirect[dinode->dindir_cnt-1], &d_block);
-    
-    /* We've just got the level 1 block, so now we have to get the level 2 block. */
-
-    while (dinode->dindir_curr_usage < INDIR_BLOCK_PTRS)
-    { 
-      /* No level 2 block exists or current level 2 block is full. */
-      if (dinode->dindir_curr_usage == 0 || dinode->dindir_lv2_curr_usage == INDIR_BLOCK_PTRS)
-      {
-        dinode->dindir_curr_usage++;
-        free_map_allocate(1, &d_block.ptr[dinode->dindir_curr_usage-1]);
-        dinode->dindir_lv2_curr_usage = 0;
-      }
-
-      block_read(fs_device, d_block.ptr[dinode->dindir_curr_usage-1], &block);
-      
-      /* We've just got the level 2 block, so now we have to get the actual data block. */
+      bool is_data = level == depth;
+      bool allocated = *slot == HOLE;
 
-      while (dinode->dindir_lv2_curr_usage < INDIR_BLOCK_PTRS)
-      {
-        dinode->dindir_lv2_curr_usage++;
-        free_map_allocate(1, &block.ptr[dinode->dindir_lv2_curr_usage-1]);
-        block_write(fs_device, block.ptr[dinode->dindir_lv2_curr_usage-1], zeros);
-        new_data_sectors--;
-        if (new_data_sectors == 0) break;
-      } 
-      
-      /* writing back the level 2 block */
+      if (allocated)
+        {
+          if (is_data
+              ? !alloc_data_sector (run, wanted, slot)
+              : !free_map_allocate_near (1, run->goal, slot))
+            return false;
+
+          /* Record the new pointer in its parent. */
+          if (parent == HOLE)
+            *map_changed = true;
+          else
+            journal_write (parent, &block);
+        }
+      if (is_data)
+        {
+          *sectorp = *slot;
+          *fresh = allocated;
+          return true;
+        }
 
-      block_write(fs_device, d_block.ptr[dinode->dindir_curr_usage-1], &block);
-      if (new_data_sectors == 0) break;
+      /* Descend into the index block. */
+      parent = *slot;
+      if (allocated)
+        {
+          memset (&block, 0, sizeof block);
+          journal_write (parent, &block);
+        }
+      else
+        journal_read (parent, &block);
+      slot = &block.ptr[path[level]];
     }
-    
-    /* writing back the level 1 block */
+}
 
-    block_write(fs_device, dinode->dindirect[dinode->dindir_cnt-1], &d_block);
-    if (new_data_sectors == 0) goto done;
-  }
-  
-  /* Immediately write back because there's no buffer cache. */
-  /* This failure may happen when the given file size exceeds the maximum. */
-  dinode->length = new_length - new_data_sectors*BLOCK_SECTOR_SIZE;
-  block_write (fs_device, dinode->sector, dinode);
-  return dinode->length;
-  
-done:
-  dinode->length = new_length;
-  block_write (fs_device, dinode->sector, dinode);
-  return new_length;
-}
-
-void dinode_free (struct inode_disk *dinode)
-{
-  /* Free double indirect block */
-  while (dinode->dindir_cnt != 0)
+/* A run of consecutive sectors released by map_free(), kept
+   so that the free map is updated and the file system device
+   gets a discard hint once per run instead of once per sector. */
+struct release_batch
   {
-    struct indir_block d_block, block;
-    
-    block_read(fs_device, dinode->dindirect[dinode->dindir_cnt-1], &d_block);
-     /* We've just got the level 1 block, so now we have to free the level 2 block. */
-
-    while (dinode->dindir_curr_usage != 0)
-    { 
-      block_read(fs_device, d_block.ptr[dinode->dindir_curr_usage-1], &block);
-      /* We've just got the level 2 block, so now we have to free the actual data block. */
-
-      while (dinode->dindir_lv2_curr_usage != 0)
-      {
-        free_map_release(block.ptr[dinode->dindir_lv2_curr_usage-1],1);
-        dinode->dindir_lv2_curr_usage--;
-      } 
-      
-      /* erase the level 2 block */
-      free_map_release(d_block.ptr[dinode->dindir_curr_usage-1],1);
-      dinode->dindir_curr_usage--;
-      if(dinode->dindir_curr_usage != 0) dinode->dindir_lv2_curr_usage = INDIR_BLOCK_PTRS;
+    block_sector_t start;       /* First sector in the run. */
+    block_sector_t cnt;         /* Number of sectors in the run. */
+  };
+
+/* Releases the run in BATCH, if any, in the free map, passes it
+   to block_discard(), and empties BATCH. */
+static void
+release_flush (struct release_batch *batch)
+{
+  if (batch->cnt > 0)
+    {
+      free_map_release (batch->start, batch->cnt);
+      block_discard (fs_device, batch->start, batch->cnt);
     }
-    
-    /* erase the level 1 block */
-    free_map_release(dinode->dindirect[dinode->dindir_cnt-1],1);
-    dinode->dindir_cnt--;
-    if(dinode->dindir_cnt != 0) dinode->dindir_curr_usage = INDIR_BLOCK_PTRS;
-  }
-  
-  /* Free single indirect block */
-  while (dinode->indir_cnt != 0)
-  {
-    struct indir_block block; 
-
-    block_read(fs_device, dinode->indirect[dinode->indir_cnt-1], &block);
+  batch->cnt = 0;
+}
 
-    while (dinode->indir_curr_usage != 0)
+/* Adds SECTOR to BATCH, to be released, first flushing BATCH if
+   SECTOR does not extend its run at either end.  map_free()
+   releases data sectors in file order, so runs usually grow
+   upward. */
+static void
+release_sector (struct release_batch *batch, block_sector_t sector)
+{
+  if (batch->cnt > 0 && sector + 1 == batch->start)
+    batch->start = sector;
+  else if (batch->cnt == 0 || sector != batch->start + batch->cnt)
     {
-      free_map_release(block.ptr[dinode->indir_curr_usage-1],1);
-      dinode->indir_curr_usage--;
+      release_flush (batch);
+      batch->start = sector;
     }
+  batch->cnt++;
+}
 
-    free_map_release(dinode->indirect[dinode->indir_cnt-1],1);
-    dinode->indir_cnt--;
-    if(dinode->indir_cnt != 0) dinode->indir_curr_usage = INDIR_BLOCK_PTRS;
-  }
+/* Releases SECTOR, which is LEVELS levels of index blocks above
+   the data sectors it leads to, together with all of those
+   sectors, adding them to BATCH.  Does nothing for a hole. */
+static void
+release_tree (struct release_batch *batch, block_sector_t sector, int levels)
+{
+  if (sector == HOLE)
+    return;
+  if (levels > 0)
+    {
+      struct indir_block block;
+      size_t i;
 
-  while (dinode->dir_cnt != 0)
-  {
-    free_map_release (dinode->direct[dinode->dir_cnt-1],1);
-    dinode->dir_cnt--;
-  }
+      journal_read (sector, &block);
+      for (i = 0; i < INDIR_BLOCK_PTRS; i++)
+        release_tree (batch, block.ptr[i], levels - 1);
+    }
+  release_sector (batch, sector);
+}
+
+/* Releases every data sector and index block in MAP. */
+static void
+map_free (struct block_map *map)
+{
+  struct release_batch batch = {0, 0};
+  size_t i;
+
+  for (i = 0; i < DIR_BLOCKS; i++)
+    release_tree (&batch, map->direct[i], 0);
+  for (i = 0; i < INDIR_BLOCKS; i++)
+    release_tree (&batch, map->indirect[i], 1);
+  for (i = 0; i < DINDIR_BLOCKS; i++)
+    release_tree (&batch, map->dindirect[i], 2);
+  release_flush (&batch);
 }
 
 /* Initializes an inode with LENGTH bytes of data and writes the new inode 
- * to sector SECTOR on the file system device. 
- * Returns true if successful. Returns false if any allocation fails. */
+ * to sector SECTOR on the file system device.  The data starts out as
+ * zeros, stored inline if it fits and otherwise as one big hole, so no
+ * data sectors are allocated.
+ * Returns true if successful. Returns false if LENGTH is too large
+ * or memory allocation fails. */
 bool
 inode_create (block_sector_t sector, off_t length, bool isdir)
 {
@@ -274,14 +323,19 @@ inode_create (block_sector_t sector, off_t length, bool isdir)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
+  if (DIV_ROUND_UP (length, BLOCK_SECTOR_SIZE) > INODE_MAX_SECTORS)
+    return false;
+
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
   {
     disk_inode->magic = INODE_MAGIC;
     disk_inode->sector = sector;
     disk_inode->isdir = isdir;
-
-    if (length == dinode_extend (disk_inode, length)) success = true;
+    disk_inode->inlined = length <= (off_t) INODE_INLINE_SIZE;
+    disk_inode->length = length;
+    journal_write (sector, disk_inode);
+    success = true;
 
     free (disk_inode);
   }
@@ -295,6 +349,7 @@ inode_open (block_sector_t sector)
 {
   struct list_elem *e;
   struct inode *inode;
+  struct inode_disk *disk_inode;
 
   /* Check whether this inode is already open. */
   for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
@@ -310,16 +365,27 @@ inode_open (block_sector_t sector)
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
-  if (inode == NULL)
-    return NULL;
+  disk_inode = malloc (sizeof *disk_inode);
+  if (inode == NULL || disk_inode == NULL)
+    {
+      free (inode);
+      free (disk_inode);
+      return NULL;
+    }
 
-  /* Initialize. */
+  /* Initialize, keeping only the fields needed at runtime. */
+  journal_read (sector, disk_inode);
   list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  inode->length = disk_inode->length;
+  inode->isdir = disk_inode->isdir;
+  inode->inlined = disk_inode->inlined;
+  if (!inode->inlined)
+    inode->map = disk_inode->map;
+  free (disk_inode);
   return inode;
 }
 
@@ -358,8 +424,11 @@ inode_close (struct inode *inode)
     /* Deallocate all related blocks if removed. */
     if (inode->removed) 
     {
+      journal_begin ();
       free_map_release (inode->sector, 1);
-      dinode_free(&inode->data);
+      if (!inode->inlined)
+        map_free (&inode->map);
+      journal_end ();
     }
     
     free (inode); 
@@ -385,10 +454,27 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
   off_t bytes_read = 0;
   uint8_t *bounce = NULL;
 
+  if (inode->inlined)
+    {
+      /* The data is in the inode sector. */
+      struct inode_disk *disk_inode;
+      off_t inode_left = inode_length (inode) - offset;
+      if (size > inode_left)
+        size = inode_left;
+      if (size <= 0)
+        return 0;
+      disk_inode = malloc (sizeof *disk_inode);
+      if (disk_inode == NULL)
+        return 0;
+      journal_read (inode->sector, disk_inode);
+      memcpy (buffer, disk_inode->inline_data + offset, size);
+      free (disk_inode);
+      return size;
+    }
+
   while (size > 0) 
     {
-      /* Disk sector to read, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Starting byte offset within sector. */
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two.
@@ -404,10 +490,18 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      /* Disk sector to read. */
+      block_sector_t sector_idx = byte_to_sector (inode, offset);
+
+      if (sector_idx == HOLE)
+        {
+          /* Holes read as zeros. */
+          memset (buffer + bytes_read, 0, chunk_size);
+        }
+      else if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
           /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
+          read_sector (inode, sector_idx, buffer + bytes_read);
         }
       else 
         {
@@ -419,7 +513,7 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
               if (bounce == NULL)
                 break;
             }
-          block_read (fs_device, sector_idx, bounce);
+          read_sector (inode, sector_idx, bounce);
           memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
         }
       
@@ -434,46 +528,153 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 }
 
 
-/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
+/* Writes INODE's block map and length back to its inode sector.
+   INODE must not hold inline data, which lives only on disk. */
+static void
+write_dinode (struct inode *inode)
+{
+  struct inode_disk disk_inode;
+
+  ASSERT (!inode->inlined);
+
+  memset (&disk_inode, 0, sizeof disk_inode);
+  disk_inode.length = inode->length;
+  disk_inode.magic = INODE_MAGIC;
+  disk_inode.sector = inode->sector;
+  disk_inode.isdir = inode->isdir;
+  disk_inode.map = inode->map;
+  journal_write (inode->sector, &disk_inode);
+}
+
+/* Writes SIZE bytes from BUFFER into INODE's inline data at
+   OFFSET, which must stay within INODE_INLINE_SIZE, and writes
+   back the inode sector.  Returns false if memory is short. */
+static bool
+write_inline_data (struct inode *inode, const void *buffer, off_t size,
+                   off_t offset)
+{
+  struct inode_disk *disk_inode = malloc (sizeof *disk_inode);
+  if (disk_inode == NULL)
+    return false;
+
+  journal_read (inode->sector, disk_inode);
+  memcpy (disk_inode->inline_data + offset, buffer, size);
+  if (offset + size > inode->length)
+    inode->length = offset + size;
+  disk_inode->length = inode->length;
+  journal_write (inode->sector, disk_inode);
+  free (disk_inode);
+  return true;
+}
+
+/* Moves INODE's inline data out to a data sector allocated from
+   RUN, which turns the inode's inline data area back into a block
+   map.  Sets *DINODE_CHANGED to true.  Returns false if memory or
+   disk space is short. */
+static bool
+move_inline_data (struct inode *inode, struct data_run *run,
+                  bool *dinode_changed)
+{
+  struct inode_disk *disk_inode;
+  block_sector_t sector;
+  uint8_t *data;
+  bool fresh;
+
+  disk_inode = malloc (sizeof *disk_inode);
+  if (disk_inode == NULL)
+    return false;
+  journal_read (inode->sector, disk_inode);
+  data = (uint8_t *) disk_inode;
+  memmove (data, disk_inode->inline_data, inode->length);
+  memset (data + inode->length, 0, BLOCK_SECTOR_SIZE - inode->length);
+
+  inode->inlined = false;
+  memset (&inode->map, 0, sizeof inode->map);
+  if (inode->length > 0)
+    {
+      if (!allocate_sector (&inode->map, 0, run, 1, &sector, &fresh,
+                            dinode_changed))
+        {
+          inode->inlined = true;
+          free (disk_inode);
+          return false;
+        }
+      write_sector (inode, sector, data);
+    }
+  *dinode_changed = true;
+  free (disk_inode);
+  return true;
+}
+
+/* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET,
+   extending INODE if necessary.  Data sectors are allocated only
+   as they are written, so skipping past end of file leaves a hole
+   rather than zero-filling the sectors in between.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.*/
+   less than SIZE if the disk is full or an error occurs, or -1
+   if the write would exceed the maximum file size.*/
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size, off_t offset)
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
   uint8_t *bounce = NULL;
+  struct data_run run = {0, 0, inode->sector};
+  bool dinode_changed = false;
+  size_t end_idx;
 
   if (inode->deny_write_cnt)
     return 0;
 
-  if (offset + size > inode_length(inode))
-  {
-    /* file extension needed */
-    inode->data.length = dinode_extend (&inode->data, offset+size);
-    if (inode_length(inode) != offset+size) return -1;
-  }
+  end_idx = DIV_ROUND_UP (offset + size, BLOCK_SECTOR_SIZE);
+  if (end_idx > INODE_MAX_SECTORS)
+    return -1;
+
+  journal_begin ();
+  if (inode->inlined)
+    {
+      if (offset + size <= (off_t) INODE_INLINE_SIZE)
+        {
+          /* Still fits inline. */
+          if (size > 0 && write_inline_data (inode, buffer, size, offset))
+            bytes_written = size;
+          journal_end ();
+          return bytes_written;
+        }
+      else if (!move_inline_data (inode, &run, &dinode_changed))
+        {
+          /* The inode is still inlined, so its block map must not
+             be written out. */
+          if (run.left > 0)
+            free_map_release (run.next, run.left);
+          journal_end ();
+          return 0;
+        }
+    }
 
   while (size > 0) 
     {
-      /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Starting byte offset within sector, and bytes left in
+         sector. */
+      size_t idx = offset / BLOCK_SECTOR_SIZE;
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
-
-      /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
-      int min_left = inode_left < sector_left ? inode_left : sector_left;
 
       /* Number of bytes to actually write into this sector. */
-      int chunk_size = size < min_left ? size : min_left;
-      if (chunk_size <= 0)
+      int chunk_size = size < sector_left ? size : sector_left;
+
+      /* Sector to write, allocated along with the rest of this
+         write's holes if it is one. */
+      block_sector_t sector_idx;
+      bool fresh;
+      if (!allocate_sector (&inode->map, idx, &run, end_idx - idx,
+                            &sector_idx, &fresh, &dinode_changed))
         break;
 
       if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
         {
           /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          write_sector (inode, sector_idx, buffer + bytes_written);
         }
       else 
         {
@@ -487,13 +688,14 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size, off_t offs
 
           /* If the sector contains data before or after the chunk
              we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
+             first.  Otherwise, or if the sector was just
+             allocated, we start with a sector of all zeros. */
+          if ((sector_ofs > 0 || chunk_size < sector_left) && !fresh) 
+            read_sector (inode, sector_idx, bounce);
           else
             memset (bounce, 0, BLOCK_SECTOR_SIZE);
           memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+          write_sector (inode, sector_idx, bounce);
         }
 
       /* Advance. */
@@ -503,9 +705,212 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size, off_t offs
     }
   free (bounce);
 
+  /* Give back the unused part of the last run. */
+  if (run.left > 0)
+    free_map_release (run.next, run.left);
+
+  /* Extend the file to cover what was written, if anything.
+     There's no buffer cache, so the inode goes to the journal
+     right away. */
+  if (bytes_written > 0 && offset > inode->length)
+    {
+      inode->length = offset;
+      dinode_changed = true;
+    }
+  if (dinode_changed)
+    write_dinode (inode);
+  journal_end ();
+
   return bytes_written;
 }
 
+/* Visits the CNT data sector pointers in PTRS, which are part of
+   INODE's block map, in file order.  Returns true if it changed
+   any of them. */
+typedef bool leaf_func (struct inode *, block_sector_t *ptrs, size_t cnt,
+                        void *aux);
+
+/* Calls FUNC on the data sector pointers in index block SECTOR of
+   INODE and writes the block back if FUNC changed it, as one
+   journal operation. */
+static void
+visit_leaf_block (struct inode *inode, block_sector_t sector,
+                  leaf_func *func, void *aux)
+{
+  struct indir_block block;
+
+  journal_begin ();
+  journal_read (sector, &block);
+  if (func (inode, block.ptr, INDIR_BLOCK_PTRS, aux))
+    journal_write (sector, &block);
+  journal_end ();
+}
+
+/* Calls FUNC, in file order, on each group of data sector
+   pointers in INODE's block map that are stored together, either
+   in the inode itself or in a single index block, writing back
+   any group that FUNC changes.  Each group is handled as one
+   journal operation, so its changes reach the disk atomically. */
+static void
+walk_leaves (struct inode *inode, leaf_func *func, void *aux)
+{
+  struct indir_block outer;
+  size_t i, j;
+
+  ASSERT (!inode->inlined);
+
+  journal_begin ();
+  if (func (inode, inode->map.direct, DIR_BLOCKS, aux))
+    write_dinode (inode);
+  journal_end ();
+
+  for (i = 0; i < INDIR_BLOCKS; i++)
+    if (inode->map.indirect[i] != HOLE)
+      visit_leaf_block (inode, inode->map.indirect[i], func, aux);
+  for (i = 0; i < DINDIR_BLOCKS; i++)
+    if (inode->map.dindirect[i] != HOLE)
+      {
+        journal_read (inode->map.dindirect[i], &outer);
+        for (j = 0; j < INDIR_BLOCK_PTRS; j++)
+          if (outer.ptr[j] != HOLE)
+            visit_leaf_block (inode, outer.ptr[j], func, aux);
+      }
+}
+
+/* Fragmentation statistics gathered by count_fragments(). */
+struct frag_count
+  {
+    block_sector_t prev;        /* Last data sector seen. */
+    size_t fragments;           /* Runs of consecutive data sectors. */
+    size_t sectors;             /* Data sectors. */
+  };
+
+/* leaf_func for counting data sectors and the runs they form. */
+static bool
+count_fragments (struct inode *inode UNUSED, block_sector_t *ptrs,
+                 size_t cnt, void *fc_)
+{
+  struct frag_count *fc = fc_;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (ptrs[i] != HOLE)
+      {
+        if (fc->sectors == 0 || ptrs[i] != fc->prev + 1)
+          fc->fragments++;
+        fc->prev = ptrs[i];
+        fc->sectors++;
+      }
+  return false;
+}
+
+/* Returns the number of runs of consecutive sectors that INODE's
+   data is stored in, and stores the number of data sectors into
+   *SECTOR_CNT.  Data stored inline and holes take no sectors. */
+size_t
+inode_fragments (struct inode *inode, size_t *sector_cnt)
+{
+  struct frag_count fc = {HOLE, 0, 0};
+
+  if (!inode->inlined)
+    walk_leaves (inode, count_fragments, &fc);
+  *sector_cnt = fc.sectors;
+  return fc.fragments;
+}
+
+/* State for relocate_sectors(). */
+struct relocation
+  {
+    block_sector_t next;        /* Destination of next data sector. */
+    bool ok;                    /* False once a step has failed. */
+    uint8_t *buffer;            /* Sector-sized copy buffer. */
+    block_sector_t *old;        /* Sectors moved away from. */
+    size_t old_cnt;             /* Number of sectors in OLD. */
+  };
+
+/* leaf_func that moves the data sectors in PTRS to the next
+   sectors of the destination run.  The new copies are written
+   before the pointers to them.  The old sectors are only
+   recorded here; inode_defrag() releases them once the new
+   pointers have committed. */
+static bool
+relocate_sectors (struct inode *inode, block_sector_t *ptrs, size_t cnt,
+                  void *r_)
+{
+  struct relocation *r = r_;
+  size_t used = 0;
+  size_t i;
+
+  if (!r->ok)
+    return false;
+  for (i = 0; i < cnt; i++)
+    if (ptrs[i] != HOLE)
+      used++;
+  if (used == 0)
+    return false;
+  if (!free_map_allocate_at (r->next, used))
+    {
+      r->ok = false;
+      return false;
+    }
+
+  for (i = 0; i < cnt; i++)
+    if (ptrs[i] != HOLE)
+      {
+        read_sector (inode, ptrs[i], r->buffer);
+        write_sector (inode, r->next, r->buffer);
+        r->old[r->old_cnt++] = ptrs[i];
+        ptrs[i] = r->next++;
+      }
+  return true;
+}
+
+/* Moves INODE's data sectors into a single run of consecutive
+   sectors near the inode, if they are not in one already.  Index
+   blocks stay where they are.  Returns false if there is no free
+   run large enough or memory is short, in which case INODE may
+   have been partially relocated but remains intact.  The caller
+   must ensure that nothing else accesses INODE meanwhile.
+
+   The sectors that INODE's data moves out of are not released
+   until the transactions that point INODE away from them have
+   committed.  Otherwise they could be reused, by the next file
+   defragmented for example, and overwritten while a crash would
+   still leave INODE pointing at them.  A crash before the
+   release commits only leaks them. */
+bool
+inode_defrag (struct inode *inode)
+{
+  struct relocation r;
+  size_t sector_cnt;
+  size_t i;
+
+  if (inode->sector == FREE_MAP_SECTOR
+      || inode_fragments (inode, &sector_cnt) <= 1)
+    return true;
+  if (!free_map_find (sector_cnt, inode->sector, &r.next))
+    return false;
+  r.buffer = malloc (BLOCK_SECTOR_SIZE);
+  r.old = malloc (sector_cnt * sizeof *r.old);
+  if (r.buffer == NULL || r.old == NULL)
+    {
+      free (r.buffer);
+      free (r.old);
+      return false;
+    }
+  r.ok = true;
+  r.old_cnt = 0;
+  walk_leaves (inode, relocate_sectors, &r);
+
+  journal_commit ();
+  for (i = 0; i < r.old_cnt; i++)
+    free_map_release (r.old[i], 1);
+
+  free (r.old);
+  free (r.buffer);
+  return r.ok;
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -530,14 +935,14 @@ inode_allow_write (struct inode *inode)
 off_t
 inode_length (const struct inode *inode)
 {
-  return inode->data.length;
+  return inode->length;
 }
 
 /* Returns whether inode is directory or not */
 bool
 inode_is_dir (struct inode *inode)
 {
-  return inode->data.isdir;
+  return inode->isdir;
 }
 
 /* Returns whether inode is removed or not */
@@ -16,6 +16,19 @@ struct bitmap;
 /* 4 bytes pointers on a 512 bytes sector */
 #define INDIR_BLOCK_PTRS 128
 
+/* Bytes of data that fit in the inode sector itself, in place of
+   the block map. */
+#define INODE_INLINE_SIZE (BLOCK_SECTOR_SIZE - 4 * sizeof (uint32_t))
+
+/* Data blocks.  A pointer of 0 is a hole: the sectors it would
+   lead to have not been written and read as zeros. */
+struct block_map
+  {
+    block_sector_t direct[DIR_BLOCKS]; 
+    block_sector_t indirect[INDIR_BLOCKS];   /* Single indirect */
+    block_sector_t dindirect[DINDIR_BLOCKS]; /* Double indirect */
+  };
+
 /* On-disk inode. Must be exactly BLOCK_SECTOR_SIZE(512) bytes long. */
 struct inode_disk
   {
@@ -23,22 +36,23 @@ struct inode_disk
     unsigned magic;                     /* Magic number. */
     block_sector_t sector;              /* Location of itself */
     bool isdir;
+    bool inlined;                       /* Data stored in INLINE_DATA? */
+    uint16_t unused;                    /* Not used. */
 
-    /* Data blocks */
-    off_t dir_cnt;
-    block_sector_t direct[DIR_BLOCKS]; 
-    off_t indir_cnt;
-    off_t indir_curr_usage;
-    block_sector_t indirect[INDIR_BLOCKS];   /* Single indirect */
-    off_t dindir_cnt;
-    off_t dindir_curr_usage;
-    off_t dindir_lv2_curr_usage;
-    block_sector_t dindirect[DINDIR_BLOCKS]; /* Double indirect */
-    
-    uint32_t unused[98];               /* Not used. */
+    union
+      {
+        struct block_map map;           /* Data blocks, unless INLINED. */
+
+        /* The data itself, for a file that has always been small
+           enough, so that reading it takes no more I/O than
+           reading the inode. */
+        uint8_t inline_data[INODE_INLINE_SIZE];
+      };
   };
 
-/* In-memory inode. */
+/* In-memory inode.  Holds only the fields of the on-disk inode
+   that are needed at runtime; the inode sector itself is fetched
+   through the journal when inline data is accessed. */
 struct inode 
   {
     struct list_elem elem;              /* Element in inode list. */
@@ -46,8 +60,10 @@ struct inode
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
-    struct inode_disk data;             /* Inode content. */
-    block_sector_t parent;		/* Sector number of parent directory */
+    off_t length;                       /* File size in bytes. */
+    bool isdir;                         /* True if a directory. */
+    bool inlined;                       /* Data stored in the inode sector? */
+    struct block_map map;               /* Data blocks, unless INLINED. */
   };
 
 
@@ -66,5 +82,7 @@ off_t inode_length (const struct inode *);
 bool inode_is_dir (struct inode *);
 bool inode_is_removed (struct inode *);
 int inode_number (struct inode *);
+size_t inode_fragments (struct inode *, size_t *sector_cnt);
+bool inode_defrag (struct inode *);
 
 #endif /* filesys/inode.h */
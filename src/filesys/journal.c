@@ -0,0 +1,573 @@
+#include "filesys/journal.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Write-ahead journal for file system metadata.
+
+   Inode sectors, indirect blocks, directory contents, and the
+   free map are never written in place directly.  Instead, the
+   new contents of each such sector are kept in memory as part of
+   the running transaction.  Committing the transaction appends a
+   descriptor sector, which lists the sectors' home locations, the
+   sector images themselves, and finally a commit sector to the
+   log, a fixed area of the file system device.  Only when the
+   log is nearly full are the images written to their home
+   locations ("checkpointed") and the log reset.
+
+   A transaction groups the updates of every operation bracketed
+   by journal_begin() and journal_end() since the previous commit.
+   To batch commits, a transaction is committed only once no
+   operation is in progress and JOURNAL_BATCH operations have
+   completed or the transaction is half full.  An operation that
+   touches more than JOURNAL_TXN_MAX sectors is split across
+   transactions, so only operations up to that size are atomic.
+
+   When a sector whose image may be in the log is freed, the
+   running transaction records a "revoke" for it, so that replay
+   won't overwrite the sector after it has been reused for file
+   data, which is not journaled.
+
+   At mount time, journal_open() replays the committed
+   transactions in the log, recovering from a crash at any point.
+   The journal superblock, in sector JOURNAL_SECTOR, records the
+   log's location and the sequence number of the first
+   transaction in it; transactions with other sequence numbers
+   are stale and ignored. */
+
+/* Magic numbers. */
+#define JOURNAL_MAGIC 0x4c4e524a        /* Superblock: "JRNL". */
+#define DESC_MAGIC 0x43534544           /* Descriptor: "DESC". */
+#define COMMIT_MAGIC 0x4d4d4f43         /* Commit: "COMM". */
+
+#define JOURNAL_SIZE 128        /* Sectors in the log. */
+#define JOURNAL_TXN_MAX 48      /* Max sectors + revokes per transaction. */
+#define JOURNAL_BATCH 16        /* Operations per commit. */
+
+/* Number of sector numbers that fit in a descriptor. */
+#define DESC_ENTRIES ((BLOCK_SECTOR_SIZE - 4 * sizeof (uint32_t)) \
+                      / sizeof (block_sector_t))
+
+/* On-disk journal superblock.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct journal_super
+  {
+    uint32_t magic;             /* JOURNAL_MAGIC. */
+    block_sector_t start;       /* First sector of the log. */
+    uint32_t size;              /* Number of sectors in the log. */
+    uint32_t seq;               /* Sequence number of first transaction. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 4 * sizeof (uint32_t)];
+  };
+
+/* On-disk transaction descriptor, the first sector of a
+   transaction in the log.  It is followed by IMAGE_CNT sector
+   images and then a commit sector. */
+struct journal_desc
+  {
+    uint32_t magic;             /* DESC_MAGIC. */
+    uint32_t seq;               /* Transaction sequence number. */
+    uint32_t image_cnt;         /* Number of sector images. */
+    uint32_t revoke_cnt;        /* Number of revoked sectors. */
+    block_sector_t sectors[DESC_ENTRIES];  /* Image homes, then revokes. */
+  };
+
+/* On-disk commit record, the last sector of a transaction. */
+struct journal_commit
+  {
+    uint32_t magic;             /* COMMIT_MAGIC. */
+    uint32_t seq;               /* Transaction sequence number. */
+    uint32_t image_cnt;         /* Number of sector images. */
+    uint8_t unused[BLOCK_SECTOR_SIZE - 3 * sizeof (uint32_t)];
+  };
+
+/* A metadata sector whose latest contents are in memory, either
+   in the running transaction or committed to the log but not yet
+   checkpointed. */
+struct journal_block
+  {
+    struct hash_elem hash_elem;         /* Element in BLOCKS. */
+    struct list_elem txn_elem;          /* Element in TXN_BLOCKS. */
+    block_sector_t sector;              /* Home sector. */
+    bool in_txn;                        /* In running transaction? */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* Latest contents. */
+  };
+
+static struct lock journal_lock;        /* Protects everything below. */
+static bool active;                     /* False until journal_open(). */
+static struct journal_super super;      /* Superblock. */
+static uint32_t seq;                    /* Running transaction's number. */
+static block_sector_t log_pos;          /* Next free sector in log. */
+static struct ohash blocks;             /* All journal_blocks. */
+
+/* Running transaction. */
+static struct list txn_blocks;          /* Sectors to log. */
+static size_t txn_image_cnt;            /* Length of TXN_BLOCKS. */
+static block_sector_t txn_revokes[JOURNAL_TXN_MAX];  /* Revoked sectors. */
+static size_t txn_revoke_cnt;           /* Number of TXN_REVOKES. */
+static int handle_cnt;                  /* Operations in progress. */
+static int op_cnt;                      /* Operations completed. */
+
+static void replay (void);
+static void commit (void);
+static void checkpoint (void);
+static struct journal_block *lookup (block_sector_t);
+static hash_hash_func block_hash;
+static hash_less_func block_less;
+static hash_action_func block_free;
+
+/* Creates an empty journal on the file system device.  Called
+   while formatting, with the free map open. */
+void
+journal_create (void)
+{
+  static uint8_t zeros[BLOCK_SECTOR_SIZE];
+  uint32_t old_seq;
+  size_t i;
+
+  /* If the device held a journal before, every transaction ever
+     written to it has a sequence number below its superblock's
+     plus JOURNAL_SIZE, so starting above that keeps leftover
+     transactions from being replayed without having to clear the
+     log. */
+  block_read (fs_device, JOURNAL_SECTOR, &super);
+  old_seq = super.magic == JOURNAL_MAGIC ? super.seq : 0;
+
+  memset (&super, 0, sizeof super);
+  super.magic = JOURNAL_MAGIC;
+  super.size = JOURNAL_SIZE;
+  super.seq = old_seq + JOURNAL_SIZE;
+  if (!free_map_allocate (JOURNAL_SIZE, &super.start))
+    PANIC ("journal creation failed");
+
+  /* Otherwise, clear out anything that might look like a
+     transaction left over from an earlier file system. */
+  if (old_seq == 0)
+    for (i = 0; i < JOURNAL_SIZE; i++)
+      block_write (fs_device, super.start + i, zeros);
+  block_write (fs_device, JOURNAL_SECTOR, &super);
+}
+
+/* Reads the journal superblock, replays any committed
+   transactions left in the log, and starts routing metadata
+   writes through the journal. */
+void
+journal_open (void)
+{
+  ASSERT (sizeof (struct journal_super) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct journal_desc) == BLOCK_SECTOR_SIZE);
+  ASSERT (sizeof (struct journal_commit) == BLOCK_SECTOR_SIZE);
+
+  lock_init (&journal_lock);
+  if (!ohash_init (&blocks, block_hash, block_less, NULL))
+    PANIC ("can't allocate memory for journal");
+  list_init (&txn_blocks);
+  txn_image_cnt = txn_revoke_cnt = 0;
+  handle_cnt = op_cnt = 0;
+
+  block_read (fs_device, JOURNAL_SECTOR, &super);
+  if (super.magic != JOURNAL_MAGIC)
+    PANIC ("file system has no journal (reformat with -f)");
+  replay ();
+  active = true;
+}
+
+/* Commits the running transaction, checkpoints the log, and
+   stops journaling. */
+void
+journal_close (void)
+{
+  if (!active)
+    return;
+
+  lock_acquire (&journal_lock);
+  commit ();
+  checkpoint ();
+  active = false;
+  lock_release (&journal_lock);
+}
+
+/* Starts an operation whose metadata updates should be
+   committed together.  Operations may nest. */
+void
+journal_begin (void)
+{
+  if (!active)
+    return;
+
+  lock_acquire (&journal_lock);
+  handle_cnt++;
+  lock_release (&journal_lock);
+}
+
+/* Ends an operation started with journal_begin(), committing
+   the running transaction if enough work has built up. */
+void
+journal_end (void)
+{
+  if (!active)
+    return;
+
+  lock_acquire (&journal_lock);
+  ASSERT (handle_cnt > 0);
+  op_cnt++;
+  if (--handle_cnt == 0
+      && (op_cnt >= JOURNAL_BATCH
+          || txn_image_cnt + txn_revoke_cnt >= JOURNAL_TXN_MAX / 2))
+    commit ();
+  lock_release (&journal_lock);
+}
+
+/* Commits the running transaction now, so that every update
+   made so far survives a crash.  Should not be called while an
+   operation is in progress, because its updates would then be
+   committed without the rest. */
+void
+journal_commit (void)
+{
+  if (!active)
+    return;
+
+  lock_acquire (&journal_lock);
+  commit ();
+  lock_release (&journal_lock);
+}
+
+/* Reads metadata SECTOR into BUFFER, taking its latest contents
+   from the journal if it has not been checkpointed yet. */
+void
+journal_read (block_sector_t sector, void *buffer)
+{
+  struct journal_block *b;
+
+  if (!active)
+    {
+      block_read (fs_device, sector, buffer);
+      return;
+    }
+
+  lock_acquire (&journal_lock);
+  b = lookup (sector);
+  if (b != NULL)
+    sector_copy (buffer, b->data);
+  else
+    block_read (fs_device, sector, buffer);
+  lock_release (&journal_lock);
+}
+
+/* Writes BUFFER as the new contents of metadata SECTOR, as part
+   of the running transaction. */
+void
+journal_write (block_sector_t sector, const void *buffer)
+{
+  struct journal_block *b;
+  size_t i;
+
+  if (!active)
+    {
+      block_write (fs_device, sector, buffer);
+      return;
+    }
+
+  lock_acquire (&journal_lock);
+  b = lookup (sector);
+  if (b == NULL || !b->in_txn)
+    {
+      if (txn_image_cnt + txn_revoke_cnt >= JOURNAL_TXN_MAX)
+        {
+          /* Committing may checkpoint and free B. */
+          commit ();
+          b = lookup (sector);
+        }
+      if (b == NULL)
+        {
+          b = malloc (sizeof *b);
+          if (b == NULL)
+            {
+              /* Out of memory.  Write through, after making sure
+                 the log holds nothing older for SECTOR. */
+              commit ();
+              checkpoint ();
+              block_write (fs_device, sector, buffer);
+              lock_release (&journal_lock);
+              return;
+            }
+          b->sector = sector;
+          ohash_insert (&blocks, &b->hash_elem);
+        }
+      b->in_txn = true;
+      list_push_back (&txn_blocks, &b->txn_elem);
+      txn_image_cnt++;
+
+      /* A write supersedes a revoke earlier in this transaction. */
+      for (i = 0; i < txn_revoke_cnt; i++)
+        if (txn_revokes[i] == sector)
+          {
+            txn_revokes[i] = txn_revokes[--txn_revoke_cnt];
+            break;
+          }
+    }
+  sector_copy (b->data, buffer);
+  lock_release (&journal_lock);
+}
+
+/* Notes that the CNT sectors starting at SECTOR have been freed,
+   so that no image of them is replayed or checkpointed. */
+void
+journal_revoke (block_sector_t sector, size_t cnt)
+{
+  block_sector_t end = sector + cnt;
+
+  if (!active)
+    return;
+
+  lock_acquire (&journal_lock);
+  for (; sector < end; sector++)
+    {
+      struct journal_block *b = lookup (sector);
+
+      /* A sector not in BLOCKS has no image in the log, because
+         images stay in BLOCKS until they are checkpointed. */
+      if (b == NULL)
+        continue;
+      if (b->in_txn)
+        {
+          list_remove (&b->txn_elem);
+          txn_image_cnt--;
+        }
+      ohash_delete (&blocks, &b->hash_elem);
+      free (b);
+
+      if (txn_image_cnt + txn_revoke_cnt >= JOURNAL_TXN_MAX)
+        commit ();
+      txn_revokes[txn_revoke_cnt++] = sector;
+    }
+  lock_release (&journal_lock);
+}
+
+/* Returns true if the log contains a valid transaction numbered
+   SEQ_ at POS, and if so reads its descriptor into DESC. */
+static bool
+read_txn (block_sector_t pos, uint32_t seq_, struct journal_desc *desc)
+{
+  struct journal_commit c;
+
+  if (pos + 2 > super.size)
+    return false;
+  block_read (fs_device, super.start + pos, desc);
+  if (desc->magic != DESC_MAGIC || desc->seq != seq_
+      || desc->image_cnt + desc->revoke_cnt > DESC_ENTRIES
+      || pos + desc->image_cnt + 2 > super.size)
+    return false;
+
+  block_read (fs_device, super.start + pos + desc->image_cnt + 1, &c);
+  return (c.magic == COMMIT_MAGIC && c.seq == seq_
+          && c.image_cnt == desc->image_cnt);
+}
+
+/* Returns true if SECTOR is revoked by any of the CNT
+   transactions in DESCS[]. */
+static bool
+is_revoked (const struct journal_desc *descs, size_t cnt,
+            block_sector_t sector)
+{
+  size_t t, i;
+
+  for (t = 0; t < cnt; t++)
+    for (i = 0; i < descs[t].revoke_cnt; i++)
+      if (descs[t].sectors[descs[t].image_cnt + i] == sector)
+        return true;
+  return false;
+}
+
+/* Writes the sector images of every committed transaction in the
+   log to their home locations, except for images revoked by the
+   same or a later transaction, then empties the log. */
+static void
+replay (void)
+{
+  struct journal_desc *descs;
+  block_sector_t pos, *starts;
+  size_t txn_cnt, t, i;
+  uint8_t *image;
+
+  descs = malloc (JOURNAL_SIZE / 2 * sizeof *descs);
+  starts = malloc (JOURNAL_SIZE / 2 * sizeof *starts);
+  image = malloc (BLOCK_SECTOR_SIZE);
+  if (descs == NULL || starts == NULL || image == NULL)
+    PANIC ("can't allocate memory for journal replay");
+
+  /* Find the committed transactions. */
+  pos = 0;
+  for (txn_cnt = 0; txn_cnt < JOURNAL_SIZE / 2; txn_cnt++)
+    {
+      if (!read_txn (pos, super.seq + txn_cnt, &descs[txn_cnt]))
+        break;
+      starts[txn_cnt] = pos;
+      pos += descs[txn_cnt].image_cnt + 2;
+    }
+
+  /* Copy their images home, oldest first. */
+  for (t = 0; t < txn_cnt; t++)
+    for (i = 0; i < descs[t].image_cnt; i++)
+      {
+        block_sector_t home = descs[t].sectors[i];
+        if (is_revoked (descs + t, txn_cnt - t, home))
+          continue;
+        block_read (fs_device, super.start + starts[t] + 1 + i, image);
+        block_write (fs_device, home, image);
+      }
+
+  if (txn_cnt > 0)
+    {
+      printf ("journal: replayed %zu transaction(s)\n", txn_cnt);
+      super.seq += txn_cnt;
+      block_write (fs_device, JOURNAL_SECTOR, &super);
+    }
+  seq = super.seq;
+  log_pos = 0;
+
+  free (image);
+  free (starts);
+  free (descs);
+}
+
+/* Appends the running transaction to the log and starts a new
+   one, then checkpoints if the log may not have room for another
+   full transaction.  The caller must hold JOURNAL_LOCK. */
+static void
+commit (void)
+{
+  static struct journal_desc desc;
+  static struct journal_commit c;
+  struct block_request *reqs[JOURNAL_TXN_MAX];
+  block_sector_t base = super.start + log_pos;
+  struct list_elem *e;
+  size_t i;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  if (txn_image_cnt == 0 && txn_revoke_cnt == 0)
+    return;
+
+  /* Descriptor. */
+  memset (&desc, 0, sizeof desc);
+  desc.magic = DESC_MAGIC;
+  desc.seq = seq;
+  desc.image_cnt = txn_image_cnt;
+  desc.revoke_cnt = txn_revoke_cnt;
+  i = 0;
+  for (e = list_begin (&txn_blocks); e != list_end (&txn_blocks);
+       e = list_next (e))
+    desc.sectors[i++] = list_entry (e, struct journal_block, txn_elem)->sector;
+  memcpy (desc.sectors + i, txn_revokes, txn_revoke_cnt * sizeof *txn_revokes);
+
+  /* The descriptor and images can go out in any order, so let the
+     block layer merge them into a few large writes, but they must
+     all be on disk before the commit record. */
+  block_write (fs_device, base, &desc);
+  i = 0;
+  for (e = list_begin (&txn_blocks); e != list_end (&txn_blocks);
+       e = list_next (e))
+    {
+      struct journal_block *b = list_entry (e, struct journal_block, txn_elem);
+      reqs[i] = block_write_async (fs_device, base + 1 + i, b->data);
+      i++;
+    }
+  for (i = 0; i < txn_image_cnt; i++)
+    block_wait (reqs[i]);
+
+  memset (&c, 0, sizeof c);
+  c.magic = COMMIT_MAGIC;
+  c.seq = seq;
+  c.image_cnt = txn_image_cnt;
+  block_write (fs_device, base + 1 + txn_image_cnt, &c);
+
+  /* Start a new transaction. */
+  log_pos += txn_image_cnt + 2;
+  seq++;
+  while (!list_empty (&txn_blocks))
+    {
+      e = list_pop_front (&txn_blocks);
+      list_entry (e, struct journal_block, txn_elem)->in_txn = false;
+    }
+  txn_image_cnt = txn_revoke_cnt = 0;
+  op_cnt = 0;
+
+  if (super.size - log_pos < JOURNAL_TXN_MAX + 2)
+    checkpoint ();
+}
+
+/* Writes every committed sector image to its home location and
+   empties the log.  The running transaction must be empty.  The
+   caller must hold JOURNAL_LOCK. */
+static void
+checkpoint (void)
+{
+  struct block_request *reqs[JOURNAL_TXN_MAX];
+  struct ohash_iterator i;
+  size_t req_cnt = 0;
+
+  ASSERT (lock_held_by_current_thread (&journal_lock));
+  ASSERT (list_empty (&txn_blocks));
+
+  ohash_first (&i, &blocks);
+  while (ohash_next (&i))
+    {
+      struct journal_block *b = hash_entry (ohash_cur (&i),
+                                            struct journal_block, hash_elem);
+      if (req_cnt == JOURNAL_TXN_MAX)
+        while (req_cnt > 0)
+          block_wait (reqs[--req_cnt]);
+      reqs[req_cnt++] = block_write_async (fs_device, b->sector, b->data);
+    }
+  while (req_cnt > 0)
+    block_wait (reqs[--req_cnt]);
+  ohash_clear (&blocks, block_free);
+
+  /* Writing the superblock with the next sequence number
+     invalidates every transaction now in the log. */
+  super.seq = seq;
+  block_write (fs_device, JOURNAL_SECTOR, &super);
+  log_pos = 0;
+}
+
+/* Returns the journal_block for SECTOR, or a null pointer if
+   there is none. */
+static struct journal_block *
+lookup (block_sector_t sector)
+{
+  struct journal_block b;
+  struct hash_elem *e;
+
+  b.sector = sector;
+  e = ohash_find (&blocks, &b.hash_elem);
+  return e != NULL ? hash_entry (e, struct journal_block, hash_elem) : NULL;
+}
+
+/* Returns a hash value for journal_block E. */
+static unsigned
+block_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct journal_block, hash_elem)->sector);
+}
+
+/* Returns true if journal_block A precedes journal_block B. */
+static bool
+block_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct journal_block, hash_elem)->sector
+          < hash_entry (b, struct journal_block, hash_elem)->sector);
+}
+
+/* Frees journal_block E. */
+static void
+block_free (struct hash_elem *e, void *aux UNUSED)
+{
+  free (hash_entry (e, struct journal_block, hash_elem));
+}
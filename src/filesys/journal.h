@@ -0,0 +1,19 @@
+#ifndef FILESYS_JOURNAL_H
+#define FILESYS_JOURNAL_H
+
+#include <stddef.h>
+#include "devices/block.h"
+
+void journal_create (void);
+void journal_open (void);
+void journal_close (void);
+
+void journal_begin (void);
+void journal_end (void);
+void journal_commit (void);
+
+void journal_read (block_sector_t, void *);
+void journal_write (block_sector_t, const void *);
+void journal_revoke (block_sector_t, size_t);
+
+#endif /* filesys/journal.h */
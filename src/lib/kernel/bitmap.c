@@ -358,6 +358,23 @@ bitmap_write (const struct bitmap *b, struct file *file)
   off_t size = byte_cnt (b->bit_cnt);
   return file_write_at (file, b->bits, size, 0) == size;
 }
+
+/* Writes the part of B that holds the CNT bits starting at START
+   to the same place in FILE, rounded out to whole elements.
+   Return true if successful, false otherwise. */
+bool
+bitmap_write_part (const struct bitmap *b, struct file *file,
+                   size_t start, size_t cnt)
+{
+  off_t ofs, size;
+
+  ASSERT (start <= b->bit_cnt);
+  ASSERT (start + cnt <= b->bit_cnt);
+
+  ofs = start / ELEM_BITS * sizeof (elem_type);
+  size = byte_cnt (start + cnt) - ofs;
+  return file_write_at (file, (uint8_t *) b->bits + ofs, size, ofs) == size;
+}
 #endif /* FILESYS */
 
 /* Debugging. */
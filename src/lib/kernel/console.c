@@ -9,6 +9,17 @@
 
 static void vprintf_helper (char, void *);
 static void putchar_have_lock (uint8_t c);
+static void putbuf_have_lock (const char *, size_t);
+
+/* Output buffered by vprintf(), so that formatted text reaches
+   the serial port a buffer at a time rather than a byte at a
+   time. */
+struct vprintf_buffer
+  {
+    int char_cnt;               /* Characters output so far. */
+    size_t len;                 /* Characters in BUF. */
+    char buf[64];               /* Pending characters. */
+  };
 
 /* The console lock.
    Both the vga and serial layers do their own locking, so it's
@@ -125,13 +136,16 @@ console_locked_by_current_thread (void)
 int
 vprintf (const char *format, va_list args) 
 {
-  int char_cnt = 0;
+  struct vprintf_buffer b;
 
+  b.char_cnt = 0;
+  b.len = 0;
   acquire_console ();
-  __vprintf (format, args, vprintf_helper, &char_cnt);
+  __vprintf (format, args, vprintf_helper, &b);
+  putbuf_have_lock (b.buf, b.len);
   release_console ();
 
-  return char_cnt;
+  return b.char_cnt;
 }
 
 /* Writes string S to the console, followed by a new-line
@@ -153,8 +167,7 @@ void
 putbuf (const char *buffer, size_t n) 
 {
   acquire_console ();
-  while (n-- > 0)
-    putchar_have_lock (*buffer++);
+  putbuf_have_lock (buffer, n);
   release_console ();
 }
 
@@ -171,11 +184,17 @@ putchar (int c)
 
 /* Helper function for vprintf(). */
 static void
-vprintf_helper (char c, void *char_cnt_) 
+vprintf_helper (char c, void *b_) 
 {
-  int *char_cnt = char_cnt_;
-  (*char_cnt)++;
-  putchar_have_lock (c);
+  struct vprintf_buffer *b = b_;
+
+  b->char_cnt++;
+  if (b->len >= sizeof b->buf)
+    {
+      putbuf_have_lock (b->buf, b->len);
+      b->len = 0;
+    }
+  b->buf[b->len++] = c;
 }
 
 /* Writes C to the vga display and serial port.
@@ -189,3 +208,16 @@ putchar_have_lock (uint8_t c)
   serial_putc (c);
   vga_putc (c);
 }
+
+/* Writes the N characters in BUFFER to the vga display and
+   serial port.  The caller has already acquired the console lock
+   if appropriate. */
+static void
+putbuf_have_lock (const char *buffer, size_t n) 
+{
+  ASSERT (console_locked_by_current_thread ());
+  write_cnt += n;
+  serial_write (buffer, n);
+  while (n-- > 0)
+    vga_putc (*buffer++);
+}
@@ -7,6 +7,7 @@
 
 #include "hash.h"
 #include "../debug.h"
+#include "../string.h"
 #include "threads/malloc.h"
 
 #define list_elem_to_hash_elem(LIST_ELEM)                       \
@@ -257,50 +258,109 @@ hash_empty (struct hash *h)
   return h->elem_cnt == 0;
 }
 
-/* Fowler-Noll-Vo hash constants, for 32-bit word sizes. */
-#define FNV_32_PRIME 16777619u
-#define FNV_32_BASIS 2166136261u
+/* MurmurHash3 constants, for 32-bit words. */
+#define MURMUR_C1 0xcc9e2d51u
+#define MURMUR_C2 0x1b873593u
+
+/* A 32-bit word that may be read at any alignment. */
+typedef uint32_t __attribute__ ((__may_alias__, __aligned__ (1)))
+        unaligned_word;
+
+/* Returns X rotated left by N bits. */
+static inline uint32_t
+rotl32 (uint32_t x, int n)
+{
+  return (x << n) | (x >> (32 - n));
+}
+
+/* Scrambles key word K before it is mixed into a hash. */
+static inline uint32_t
+scramble (uint32_t k)
+{
+  k *= MURMUR_C1;
+  k = rotl32 (k, 15);
+  return k * MURMUR_C2;
+}
+
+/* Mixes the bits of H so that every input bit affects every
+   output bit. */
+static inline uint32_t
+avalanche (uint32_t h)
+{
+  h ^= h >> 16;
+  h *= 0x85ebca6bu;
+  h ^= h >> 13;
+  h *= 0xc2b2ae35u;
+  h ^= h >> 16;
+  return h;
+}
 
 /* Returns a hash of the SIZE bytes in BUF. */
 unsigned
-hash_bytes (const void *buf_, size_t size)
+hash_bytes (const void *buf, size_t size)
 {
-  /* Fowler-Noll-Vo 32-bit hash, for bytes. */
-  const unsigned char *buf = buf_;
-  unsigned hash;
+  return hash_bytes_seed (buf, size, 0);
+}
+
+/* Returns a hash of the SIZE bytes in BUF, starting from SEED.
+   Different seeds give unrelated hashes of the same bytes. */
+unsigned
+hash_bytes_seed (const void *buf_, size_t size, unsigned seed)
+{
+  /* MurmurHash3 (x86, 32-bit), taking a word at a time. */
+  const uint8_t *buf = buf_;
+  uint32_t hash = seed;
+  size_t i;
 
   ASSERT (buf != NULL);
 
-  hash = FNV_32_BASIS;
-  while (size-- > 0)
-    hash = (hash * FNV_32_PRIME) ^ *buf++;
+  for (i = 0; i + 4 <= size; i += 4)
+    {
+      hash ^= scramble (*(const unaligned_word *) (buf + i));
+      hash = rotl32 (hash, 13) * 5 + 0xe6546b64u;
+    }
+
+  /* Up to 3 bytes left over, little-endian. */
+  if (i < size)
+    {
+      uint32_t k = 0;
+      size_t j;
+
+      for (j = size; j > i; j--)
+        k = (k << 8) | buf[j - 1];
+      hash ^= scramble (k);
+    }
 
-  return hash;
-} 
+  return avalanche (hash ^ size);
+}
 
 /* Returns a hash of string S. */
 unsigned
-hash_string (const char *s_) 
+hash_string (const char *s)
 {
-  const unsigned char *s = (const unsigned char *) s_;
-  unsigned hash;
+  return hash_string_seed (s, 0);
+}
 
+/* Returns a hash of string S, starting from SEED.  The same as
+   hashing its bytes with hash_bytes_seed(). */
+unsigned
+hash_string_seed (const char *s, unsigned seed)
+{
   ASSERT (s != NULL);
 
-  hash = FNV_32_BASIS;
-  while (*s != '\0')
-    hash = (hash * FNV_32_PRIME) ^ *s++;
-
-  return hash;
+  return hash_bytes_seed (s, strlen (s), seed);
 }
 
-/* Returns a hash of integer I. */
+/* Returns a hash of integer I.  Mixes I's bits directly instead
+   of hashing its bytes, which suits sector and page numbers:
+   runs of nearby keys still spread evenly over all the bits of
+   the result, including the low-order bits that pick a bucket. */
 unsigned
-hash_int (int i) 
+hash_int (int i)
 {
-  return hash_bytes (&i, sizeof i);
+  return avalanche (i);
 }
-
+
 /* Returns the bucket in H that E belongs in. */
 static struct list *
 find_bucket (struct hash *h, struct hash_elem *e) 
@@ -428,3 +488,372 @@ remove_elem (struct hash *h, struct hash_elem *e)
   list_remove (&e->list_elem);
 }
 
+
+/* Open-addressing hash table. */
+
+/* Smallest number of slots in a table. */
+#define MIN_SLOTS 8
+
+/* Old slots moved into the new array by each insertion or
+   deletion while a resize is in progress.  Must be at least 2
+   for the old array to empty before the new one needs to grow
+   in turn. */
+#define MOVE_SLOTS 4
+
+/* Marks an old slot whose element has been moved or deleted.
+   Unlike an empty slot, it does not end a search, so elements
+   further along the same probe sequence can still be found. */
+static struct hash_elem moved_elem;
+#define MOVED (&moved_elem)
+
+static struct ohash_slot *search (struct ohash *, struct ohash_slot *,
+                                  size_t slot_cnt, unsigned hash,
+                                  struct hash_elem *);
+static struct ohash_slot *find_slot (struct ohash *, unsigned hash,
+                                     struct hash_elem *);
+static void place (struct ohash *, unsigned hash, struct hash_elem *);
+static void remove_slot (struct ohash *, struct ohash_slot *);
+static void move_slots (struct ohash *, size_t cnt);
+static void resize (struct ohash *, size_t slot_cnt);
+
+/* Initializes open-addressing hash table H to compute hash
+   values using HASH and compare hash elements using LESS, given
+   auxiliary data AUX. */
+bool
+ohash_init (struct ohash *h,
+            hash_hash_func *hash, hash_less_func *less, void *aux)
+{
+  h->elem_cnt = 0;
+  h->slot_cnt = MIN_SLOTS;
+  h->slots = calloc (h->slot_cnt, sizeof *h->slots);
+  h->old_slot_cnt = 0;
+  h->old_slots = NULL;
+  h->move_idx = 0;
+  h->hash = hash;
+  h->less = less;
+  h->aux = aux;
+
+  return h->slots != NULL;
+}
+
+/* Removes all the elements from H.
+
+   If DESTRUCTOR is non-null, then it is called for each element
+   in the hash, with the same restrictions as for hash_clear(). */
+void
+ohash_clear (struct ohash *h, hash_action_func *destructor)
+{
+  if (destructor != NULL)
+    ohash_apply (h, destructor);
+
+  free (h->old_slots);
+  h->old_slots = NULL;
+  h->old_slot_cnt = 0;
+  memset (h->slots, 0, h->slot_cnt * sizeof *h->slots);
+  h->elem_cnt = 0;
+}
+
+/* Destroys hash table H.
+
+   If DESTRUCTOR is non-null, then it is first called for each
+   element in the hash, with the same restrictions as for
+   hash_destroy(). */
+void
+ohash_destroy (struct ohash *h, hash_action_func *destructor)
+{
+  if (destructor != NULL)
+    ohash_clear (h, destructor);
+  free (h->old_slots);
+  free (h->slots);
+}
+
+/* Inserts NEW into hash table H and returns a null pointer, if
+   no equal element is already in the table.
+   If an equal element is already in the table, returns it
+   without inserting NEW.
+
+   If the table cannot grow for lack of memory, it keeps filling
+   up, more and more slowly, and the kernel panics when no free
+   slot at all is left. */
+struct hash_elem *
+ohash_insert (struct ohash *h, struct hash_elem *new)
+{
+  unsigned hash = h->hash (new, h->aux);
+  struct ohash_slot *s = find_slot (h, hash, new);
+
+  if (s != NULL)
+    return s->elem;
+
+  if ((h->elem_cnt + 1) * 4 > h->slot_cnt * 3)
+    resize (h, h->slot_cnt * 2);
+  if (h->elem_cnt + 1 >= h->slot_cnt)
+    PANIC ("hash table full");
+  place (h, hash, new);
+  h->elem_cnt++;
+  move_slots (h, MOVE_SLOTS);
+
+  return NULL;
+}
+
+/* Inserts NEW into hash table H, replacing any equal element
+   already in the table, which is returned. */
+struct hash_elem *
+ohash_replace (struct ohash *h, struct hash_elem *new)
+{
+  unsigned hash = h->hash (new, h->aux);
+  struct ohash_slot *s = find_slot (h, hash, new);
+  struct hash_elem *old;
+
+  if (s == NULL)
+    return ohash_insert (h, new);
+
+  /* An equal element has the same hash value, so NEW can take
+     over its slot. */
+  old = s->elem;
+  s->elem = new;
+  return old;
+}
+
+/* Finds and returns an element equal to E in hash table H, or a
+   null pointer if no equal element exists in the table. */
+struct hash_elem *
+ohash_find (struct ohash *h, struct hash_elem *e)
+{
+  struct ohash_slot *s = find_slot (h, h->hash (e, h->aux), e);
+  return s != NULL ? s->elem : NULL;
+}
+
+/* Finds, removes, and returns an element equal to E in hash
+   table H.  Returns a null pointer if no equal element existed
+   in the table.
+
+   If the elements of the hash table are dynamically allocated,
+   or own resources that are, then it is the caller's
+   responsibility to deallocate them. */
+struct hash_elem *
+ohash_delete (struct ohash *h, struct hash_elem *e)
+{
+  unsigned hash = h->hash (e, h->aux);
+  struct ohash_slot *s;
+  struct hash_elem *found;
+
+  s = search (h, h->slots, h->slot_cnt, hash, e);
+  if (s != NULL)
+    {
+      found = s->elem;
+      remove_slot (h, s);
+    }
+  else if (h->old_slots != NULL
+           && (s = search (h, h->old_slots, h->old_slot_cnt, hash, e)))
+    {
+      found = s->elem;
+      s->elem = MOVED;
+    }
+  else
+    return NULL;
+
+  h->elem_cnt--;
+  move_slots (h, MOVE_SLOTS);
+  if (h->old_slots == NULL && h->slot_cnt > MIN_SLOTS
+      && h->elem_cnt * 8 < h->slot_cnt)
+    resize (h, h->slot_cnt / 2);
+
+  return found;
+}
+
+/* Calls ACTION for each element in hash table H in arbitrary
+   order, with the same restrictions as for hash_apply(). */
+void
+ohash_apply (struct ohash *h, hash_action_func *action)
+{
+  struct ohash_iterator i;
+
+  ASSERT (action != NULL);
+
+  ohash_first (&i, h);
+  while (ohash_next (&i))
+    action (ohash_cur (&i), h->aux);
+}
+
+/* Initializes I for iterating hash table H.  The idiom is the
+   same as for hash_first(), and so is the rule that modifying
+   the table invalidates all iterators. */
+void
+ohash_first (struct ohash_iterator *i, struct ohash *h)
+{
+  ASSERT (i != NULL);
+  ASSERT (h != NULL);
+
+  i->hash = h;
+  i->idx = 0;
+  i->elem = NULL;
+}
+
+/* Advances I to the next element in the hash table and returns
+   it.  Returns a null pointer if no elements are left.  Elements
+   are returned in arbitrary order. */
+struct hash_elem *
+ohash_next (struct ohash_iterator *i)
+{
+  struct ohash *h;
+
+  ASSERT (i != NULL);
+
+  h = i->hash;
+  while (i->idx < h->old_slot_cnt + h->slot_cnt)
+    {
+      struct ohash_slot *s = (i->idx < h->old_slot_cnt
+                              ? &h->old_slots[i->idx]
+                              : &h->slots[i->idx - h->old_slot_cnt]);
+      i->idx++;
+      if (s->elem != NULL && s->elem != MOVED)
+        return i->elem = s->elem;
+    }
+  return i->elem = NULL;
+}
+
+/* Returns the current element in the hash table iteration, or a
+   null pointer at the end of the table.  Undefined behavior
+   after calling ohash_first() but before ohash_next(). */
+struct hash_elem *
+ohash_cur (struct ohash_iterator *i)
+{
+  return i->elem;
+}
+
+/* Returns the number of elements in H. */
+size_t
+ohash_size (struct ohash *h)
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H contains no elements, false otherwise. */
+bool
+ohash_empty (struct ohash *h)
+{
+  return h->elem_cnt == 0;
+}
+
+/* Searches the SLOT_CNT slots in SLOTS, which belong to H, for
+   an element equal to E, whose hash value is HASH.  Returns its
+   slot if found or a null pointer otherwise. */
+static struct ohash_slot *
+search (struct ohash *h, struct ohash_slot *slots, size_t slot_cnt,
+        unsigned hash, struct hash_elem *e)
+{
+  size_t mask = slot_cnt - 1;
+  size_t i;
+
+  for (i = hash & mask; slots[i].elem != NULL; i = (i + 1) & mask)
+    {
+      struct ohash_slot *s = &slots[i];
+      if (s->hash == hash && s->elem != MOVED
+          && !h->less (s->elem, e, h->aux) && !h->less (e, s->elem, h->aux))
+        return s;
+    }
+  return NULL;
+}
+
+/* Returns the slot, old or new, that holds an element equal to
+   E, whose hash value is HASH, in H, or a null pointer if there
+   is none. */
+static struct ohash_slot *
+find_slot (struct ohash *h, unsigned hash, struct hash_elem *e)
+{
+  struct ohash_slot *s = search (h, h->slots, h->slot_cnt, hash, e);
+  if (s == NULL && h->old_slots != NULL)
+    s = search (h, h->old_slots, h->old_slot_cnt, hash, e);
+  return s;
+}
+
+/* Puts E, whose hash value is HASH, into the first free slot
+   along its probe sequence in H's current slots.  Does not
+   update H's element count. */
+static void
+place (struct ohash *h, unsigned hash, struct hash_elem *e)
+{
+  size_t mask = h->slot_cnt - 1;
+  size_t i;
+
+  for (i = hash & mask; h->slots[i].elem != NULL; i = (i + 1) & mask)
+    continue;
+  h->slots[i].hash = hash;
+  h->slots[i].elem = e;
+}
+
+/* Empties slot S among H's current slots, then moves later
+   elements of the same run of full slots back into the gap
+   wherever that keeps them reachable from their home slots, so
+   that no search stops short of an element. */
+static void
+remove_slot (struct ohash *h, struct ohash_slot *s)
+{
+  size_t mask = h->slot_cnt - 1;
+  size_t hole = s - h->slots;
+  size_t i = hole;
+
+  for (;;)
+    {
+      size_t home;
+
+      i = (i + 1) & mask;
+      if (h->slots[i].elem == NULL)
+        break;
+
+      /* The element in slot I may fill the hole only if the hole
+         lies between its home slot and slot I. */
+      home = h->slots[i].hash & mask;
+      if (((i - home) & mask) >= ((i - hole) & mask))
+        {
+          h->slots[hole] = h->slots[i];
+          hole = i;
+        }
+    }
+  h->slots[hole].elem = NULL;
+}
+
+/* Moves up to CNT old slots' elements in H into the current
+   slots, freeing the old slots after the last one. */
+static void
+move_slots (struct ohash *h, size_t cnt)
+{
+  while (cnt-- > 0 && h->old_slots != NULL)
+    {
+      struct ohash_slot *s = &h->old_slots[h->move_idx++];
+      if (s->elem != NULL && s->elem != MOVED)
+        {
+          place (h, s->hash, s->elem);
+          s->elem = MOVED;
+        }
+
+      if (h->move_idx >= h->old_slot_cnt)
+        {
+          free (h->old_slots);
+          h->old_slots = NULL;
+          h->old_slot_cnt = 0;
+        }
+    }
+}
+
+/* Starts moving H's elements into a new array of SLOT_CNT
+   slots, after finishing any earlier move.  This function can
+   fail because of an out-of-memory condition, which just leaves
+   the table more crowded than it should be. */
+static void
+resize (struct ohash *h, size_t slot_cnt)
+{
+  struct ohash_slot *slots;
+
+  move_slots (h, h->old_slot_cnt);
+
+  slots = calloc (slot_cnt, sizeof *slots);
+  if (slots == NULL)
+    return;
+
+  h->old_slots = h->slots;
+  h->old_slot_cnt = h->slot_cnt;
+  h->move_idx = 0;
+  h->slots = slots;
+  h->slot_cnt = slot_cnt;
+}
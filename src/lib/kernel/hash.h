@@ -95,9 +95,86 @@ struct hash_elem *hash_cur (struct hash_iterator *);
 size_t hash_size (struct hash *);
 bool hash_empty (struct hash *);
 
-/* Sample hash functions. */
+/* Open-addressing hash table.
+
+   A variant of struct hash that keeps each element's hash value
+   and a pointer to the element side by side in one flat array of
+   slots, searched by linear probing.  A lookup usually touches
+   one or two adjacent slots and calls the comparison function
+   only for elements whose whole hash value matches, instead of
+   following list pointers through the elements themselves.
+
+   Elements embed a struct hash_elem, just as for struct hash, and
+   take the same hash_hash_func and hash_less_func; hash_entry()
+   converts back to the containing structure.  (The list_elem
+   inside the hash_elem goes unused.)
+
+   Growing or shrinking the table does not move every element at
+   once.  The old slot array is kept alongside the new one and
+   emptied a few slots at a time by later insertions and
+   deletions, with lookups searching both in the meantime. */
+
+/* Slot in an open-addressing hash table. */
+struct ohash_slot
+  {
+    unsigned hash;              /* ELEM's hash value. */
+    struct hash_elem *elem;     /* Element, or null if slot is empty. */
+  };
+
+/* Open-addressing hash table. */
+struct ohash
+  {
+    size_t elem_cnt;            /* Number of elements in table. */
+    size_t slot_cnt;            /* Number of slots, a power of 2. */
+    struct ohash_slot *slots;   /* Array of `slot_cnt' slots. */
+    size_t old_slot_cnt;        /* Number of old slots, 0 if none. */
+    struct ohash_slot *old_slots; /* Slots being moved into `slots'. */
+    size_t move_idx;            /* Next old slot to move. */
+    hash_hash_func *hash;       /* Hash function. */
+    hash_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `hash' and `less'. */
+  };
+
+/* An open-addressing hash table iterator. */
+struct ohash_iterator
+  {
+    struct ohash *hash;         /* The hash table. */
+    size_t idx;                 /* Next slot, counting old slots first. */
+    struct hash_elem *elem;     /* Current hash element. */
+  };
+
+/* Basic life cycle. */
+bool ohash_init (struct ohash *, hash_hash_func *, hash_less_func *,
+                 void *aux);
+void ohash_clear (struct ohash *, hash_action_func *);
+void ohash_destroy (struct ohash *, hash_action_func *);
+
+/* Search, insertion, deletion. */
+struct hash_elem *ohash_insert (struct ohash *, struct hash_elem *);
+struct hash_elem *ohash_replace (struct ohash *, struct hash_elem *);
+struct hash_elem *ohash_find (struct ohash *, struct hash_elem *);
+struct hash_elem *ohash_delete (struct ohash *, struct hash_elem *);
+
+/* Iteration. */
+void ohash_apply (struct ohash *, hash_action_func *);
+void ohash_first (struct ohash_iterator *, struct ohash *);
+struct hash_elem *ohash_next (struct ohash_iterator *);
+struct hash_elem *ohash_cur (struct ohash_iterator *);
+
+/* Information. */
+size_t ohash_size (struct ohash *);
+bool ohash_empty (struct ohash *);
+
+/* Sample hash functions.
+
+   hash_bytes() and hash_string() are the same as the _seed
+   versions with a seed of 0.  A table whose keys come from user
+   programs, such as file names, may pass a seed chosen at random
+   to keep them from picking keys that all collide. */
 unsigned hash_bytes (const void *, size_t);
+unsigned hash_bytes_seed (const void *, size_t, unsigned seed);
 unsigned hash_string (const char *);
+unsigned hash_string_seed (const char *, unsigned seed);
 unsigned hash_int (int);
 
 #endif /* lib/kernel/hash.h */
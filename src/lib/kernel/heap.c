@@ -0,0 +1,268 @@
+/* Binary heap.
+
+   See heap.h for basic information.
+
+   The heap is a complete binary tree: every level is full except
+   perhaps the last, which fills from the left.  Numbering the
+   elements 1, 2, 3, ... level by level, element N's children are
+   2N and 2N + 1, so the binary digits of N after the leading 1
+   spell out the path from the root to element N, 0 meaning left
+   and 1 meaning right.  That is how the heap finds the place for
+   a new element and its last element, without an array. */
+
+#include "heap.h"
+#include "../debug.h"
+
+static bool elem_less (const struct heap *, const struct heap_elem *,
+                       const struct heap_elem *);
+static struct heap_elem *nth_elem (struct heap *, size_t n);
+static void swap_with_parent (struct heap *, struct heap_elem *);
+static void replace (struct heap *, struct heap_elem *old,
+                     struct heap_elem *new);
+static void sift_up (struct heap *, struct heap_elem *);
+static void sift_down (struct heap *, struct heap_elem *);
+
+/* Initializes H as an empty heap that orders elements using
+   LESS, given auxiliary data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux)
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->root = NULL;
+  h->elem_cnt = 0;
+  h->next_seq = 0;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Inserts E into H. */
+void
+heap_push (struct heap *h, struct heap_elem *e)
+{
+  size_t n = ++h->elem_cnt;
+
+  ASSERT (e != NULL);
+
+  e->left = e->right = NULL;
+  e->seq = h->next_seq++;
+  if (n == 1)
+    {
+      e->parent = NULL;
+      h->root = e;
+      return;
+    }
+
+  /* Element N goes on the left of element N / 2 if N is even,
+     on the right if it is odd. */
+  e->parent = nth_elem (h, n / 2);
+  if (n % 2 == 0)
+    e->parent->left = e;
+  else
+    e->parent->right = e;
+  sift_up (h, e);
+}
+
+/* Removes and returns the least element in H, which must not be
+   empty. */
+struct heap_elem *
+heap_pop (struct heap *h)
+{
+  struct heap_elem *min = h->root;
+
+  ASSERT (min != NULL);
+
+  heap_remove (h, min);
+  return min;
+}
+
+/* Removes E, which must be in H, from H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e)
+{
+  struct heap_elem *last;
+
+  ASSERT (h->elem_cnt > 0);
+
+  /* Detach the last element from its parent. */
+  last = nth_elem (h, h->elem_cnt);
+  if (last->parent == NULL)
+    h->root = NULL;
+  else if (last->parent->left == last)
+    last->parent->left = NULL;
+  else
+    last->parent->right = NULL;
+  h->elem_cnt--;
+
+  /* Unless E was the last element, put the last element in its
+     place and move it to where it belongs. */
+  if (last != e)
+    {
+      replace (h, e, last);
+      if (last->parent != NULL && elem_less (h, last, last->parent))
+        sift_up (h, last);
+      else
+        sift_down (h, last);
+    }
+}
+
+/* Restores H's ordering after element E, which is in H, was
+   changed so that it compares less than it did before. */
+void
+heap_decrease_key (struct heap *h, struct heap_elem *e)
+{
+  sift_up (h, e);
+}
+
+/* Restores H's ordering after element E, which is in H, was
+   changed so that it compares greater than it did before. */
+void
+heap_increase_key (struct heap *h, struct heap_elem *e)
+{
+  sift_down (h, e);
+}
+
+/* Returns the least element in H, without removing it, or a null
+   pointer if H is empty. */
+struct heap_elem *
+heap_min (struct heap *h)
+{
+  return h->root;
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (struct heap *h)
+{
+  return h->elem_cnt;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+heap_empty (struct heap *h)
+{
+  return h->elem_cnt == 0;
+}
+
+/* Returns true if A should leave H before B: if A is less than
+   B, or if they are equal and A was pushed first. */
+static bool
+elem_less (const struct heap *h, const struct heap_elem *a,
+           const struct heap_elem *b)
+{
+  if (h->less (a, b, h->aux))
+    return true;
+  else if (h->less (b, a, h->aux))
+    return false;
+  else
+    return (int) (a->seq - b->seq) < 0;
+}
+
+/* Returns element N of H, counting from 1 in level order.  N
+   must be between 1 and the number of elements in H. */
+static struct heap_elem *
+nth_elem (struct heap *h, size_t n)
+{
+  struct heap_elem *e = h->root;
+  size_t bit;
+
+  ASSERT (n >= 1 && n <= h->elem_cnt);
+
+  /* Find the leading 1 bit, then follow the bits after it. */
+  for (bit = 1; bit <= n / 2; bit <<= 1)
+    continue;
+  for (bit >>= 1; bit > 0; bit >>= 1)
+    e = n & bit ? e->right : e->left;
+  return e;
+}
+
+/* Exchanges element E in H with its parent, which must exist. */
+static void
+swap_with_parent (struct heap *h, struct heap_elem *e)
+{
+  struct heap_elem *parent = e->parent;
+  struct heap_elem *left = e->left, *right = e->right;
+
+  /* E takes PARENT's place. */
+  e->parent = parent->parent;
+  if (e->parent == NULL)
+    h->root = e;
+  else if (e->parent->left == parent)
+    e->parent->left = e;
+  else
+    e->parent->right = e;
+
+  /* PARENT becomes E's child, on the side where E was, and E
+     takes PARENT's other child. */
+  if (parent->left == e)
+    {
+      e->left = parent;
+      e->right = parent->right;
+    }
+  else
+    {
+      e->left = parent->left;
+      e->right = parent;
+    }
+  if (e->left != parent && e->left != NULL)
+    e->left->parent = e;
+  if (e->right != parent && e->right != NULL)
+    e->right->parent = e;
+  parent->parent = e;
+
+  /* PARENT takes E's old children. */
+  parent->left = left;
+  parent->right = right;
+  if (left != NULL)
+    left->parent = parent;
+  if (right != NULL)
+    right->parent = parent;
+}
+
+/* Puts NEW, which is not in H's tree, in the place of OLD, which
+   is. */
+static void
+replace (struct heap *h, struct heap_elem *old, struct heap_elem *new)
+{
+  new->parent = old->parent;
+  new->left = old->left;
+  new->right = old->right;
+
+  if (new->parent == NULL)
+    h->root = new;
+  else if (new->parent->left == old)
+    new->parent->left = new;
+  else
+    new->parent->right = new;
+  if (new->left != NULL)
+    new->left->parent = new;
+  if (new->right != NULL)
+    new->right->parent = new;
+}
+
+/* Moves E toward the root of H until its parent is less than
+   it. */
+static void
+sift_up (struct heap *h, struct heap_elem *e)
+{
+  while (e->parent != NULL && elem_less (h, e, e->parent))
+    swap_with_parent (h, e);
+}
+
+/* Moves E away from the root of H until neither child is less
+   than it. */
+static void
+sift_down (struct heap *h, struct heap_elem *e)
+{
+  for (;;)
+    {
+      struct heap_elem *child = e->left;
+
+      if (e->right != NULL && elem_less (h, e->right, child))
+        child = e->right;
+      if (child == NULL || !elem_less (h, child, e))
+        break;
+      swap_with_parent (h, child);
+    }
+}
@@ -0,0 +1,85 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Binary heap.
+
+   A priority queue that yields its least element first, as
+   judged by a less-than function supplied to heap_init().
+   Pushing an element, popping the least one, or removing any
+   element takes O(log n) time, where keeping a list sorted with
+   list_insert_ordered() takes O(n) per insertion.
+
+   Like lists, heaps do not use dynamic allocation, so they may
+   be used from interrupt handlers.  Each structure that can
+   potentially be in a heap must embed a struct heap_elem member,
+   and heap_entry() converts a struct heap_elem back to the
+   structure that contains it.  Refer to lib/kernel/list.h for a
+   detailed explanation.  The heap is a complete binary tree
+   linked through its elements, not an array.
+
+   Elements that compare equal are popped in the order they were
+   pushed, so a heap of threads ordered by priority still takes
+   turns among threads of equal priority.
+
+   The ordering of an element must not change while it is in a
+   heap, except as follows: after changing element E so that it
+   compares less than before, as when a thread's priority is
+   raised by donation, call heap_decrease_key(); after changing
+   it so that it compares greater, call heap_increase_key(). */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+  {
+    struct heap_elem *parent;   /* Parent, or null for the root. */
+    struct heap_elem *left;     /* Left child. */
+    struct heap_elem *right;    /* Right child. */
+    unsigned seq;               /* Order of pushing, to break ties. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)                   \
+        ((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->parent           \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, that
+   is, if A should be popped first, or false if A is greater
+   than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Binary heap. */
+struct heap
+  {
+    struct heap_elem *root;     /* Least element, or null if empty. */
+    size_t elem_cnt;            /* Number of elements in heap. */
+    unsigned next_seq;          /* Sequence number for next push. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+/* Insertion and removal. */
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_pop (struct heap *);
+void heap_remove (struct heap *, struct heap_elem *);
+
+/* Reordering after a change. */
+void heap_decrease_key (struct heap *, struct heap_elem *);
+void heap_increase_key (struct heap *, struct heap_elem *);
+
+/* Properties. */
+struct heap_elem *heap_min (struct heap *);
+size_t heap_size (struct heap *);
+bool heap_empty (struct heap *);
+
+#endif /* lib/kernel/heap.h */
@@ -0,0 +1,431 @@
+/* Red-black tree.
+
+   See rbtree.h for basic information.  The algorithms are those
+   of Cormen, Leiserson, Rivest, and Stein, "Introduction to
+   Algorithms", chapter 13, with null pointers in place of the
+   sentinel leaf. */
+
+#include "rbtree.h"
+#include "../debug.h"
+
+static void rotate_left (struct rb_tree *, struct rb_elem *);
+static void rotate_right (struct rb_tree *, struct rb_elem *);
+static void insert_fixup (struct rb_tree *, struct rb_elem *);
+static void remove_fixup (struct rb_tree *, struct rb_elem *,
+                          struct rb_elem *parent);
+
+/* Initializes T as an empty tree that orders elements using
+   LESS, given auxiliary data AUX. */
+void
+rb_init (struct rb_tree *t, rb_less_func *less, void *aux)
+{
+  ASSERT (t != NULL);
+  ASSERT (less != NULL);
+
+  t->root = NULL;
+  t->elem_cnt = 0;
+  t->less = less;
+  t->aux = aux;
+}
+
+/* Inserts E into T, after any elements equal to it. */
+void
+rb_insert (struct rb_tree *t, struct rb_elem *e)
+{
+  struct rb_elem *parent = NULL;
+  struct rb_elem **link = &t->root;
+
+  ASSERT (e != NULL);
+
+  while (*link != NULL)
+    {
+      parent = *link;
+      link = t->less (e, parent, t->aux) ? &parent->left : &parent->right;
+    }
+
+  e->parent = parent;
+  e->left = e->right = NULL;
+  e->red = true;
+  *link = e;
+  t->elem_cnt++;
+
+  insert_fixup (t, e);
+}
+
+/* Returns the leftmost element in the subtree rooted at E. */
+static struct rb_elem *
+leftmost (struct rb_elem *e)
+{
+  while (e->left != NULL)
+    e = e->left;
+  return e;
+}
+
+/* Returns the rightmost element in the subtree rooted at E. */
+static struct rb_elem *
+rightmost (struct rb_elem *e)
+{
+  while (e->right != NULL)
+    e = e->right;
+  return e;
+}
+
+/* Makes NEW take OLD's place as a child of OLD's parent, or as
+   T's root. */
+static void
+replace_child (struct rb_tree *t, struct rb_elem *old, struct rb_elem *new)
+{
+  struct rb_elem *parent = old->parent;
+
+  if (parent == NULL)
+    t->root = new;
+  else if (parent->left == old)
+    parent->left = new;
+  else
+    parent->right = new;
+}
+
+/* Removes E, which must be in T, from T. */
+void
+rb_remove (struct rb_tree *t, struct rb_elem *e)
+{
+  struct rb_elem *child, *parent;
+  bool red;
+
+  ASSERT (t->elem_cnt > 0);
+
+  if (e->left != NULL && e->right != NULL)
+    {
+      /* Put E's successor, which has no left child, in E's
+         place, then fix up from where the successor was. */
+      struct rb_elem *next = leftmost (e->right);
+
+      child = next->right;
+      parent = next->parent;
+      red = next->red;
+      if (parent == e)
+        parent = next;
+      else
+        {
+          if (child != NULL)
+            child->parent = parent;
+          parent->left = child;
+          next->right = e->right;
+          e->right->parent = next;
+        }
+
+      replace_child (t, e, next);
+      next->parent = e->parent;
+      next->left = e->left;
+      e->left->parent = next;
+      next->red = e->red;
+    }
+  else
+    {
+      child = e->left != NULL ? e->left : e->right;
+      parent = e->parent;
+      red = e->red;
+      if (child != NULL)
+        child->parent = parent;
+      replace_child (t, e, child);
+    }
+  t->elem_cnt--;
+
+  if (!red)
+    remove_fixup (t, child, parent);
+}
+
+/* Returns the first element in T equal to KEY, or a null pointer
+   if there is none. */
+struct rb_elem *
+rb_find (struct rb_tree *t, const struct rb_elem *key)
+{
+  struct rb_elem *e = rb_lower_bound (t, key);
+  return e != NULL && !t->less (key, e, t->aux) ? e : NULL;
+}
+
+/* Returns the first element in T that is not less than KEY, or
+   rb_end(T) if every element is less than KEY. */
+struct rb_elem *
+rb_lower_bound (struct rb_tree *t, const struct rb_elem *key)
+{
+  struct rb_elem *e = t->root;
+  struct rb_elem *bound = NULL;
+
+  while (e != NULL)
+    if (t->less (e, key, t->aux))
+      e = e->right;
+    else
+      {
+        bound = e;
+        e = e->left;
+      }
+  return bound;
+}
+
+/* Returns the first element in T that is greater than KEY, or
+   rb_end(T) if no element is greater than KEY. */
+struct rb_elem *
+rb_upper_bound (struct rb_tree *t, const struct rb_elem *key)
+{
+  struct rb_elem *e = t->root;
+  struct rb_elem *bound = NULL;
+
+  while (e != NULL)
+    if (t->less (key, e, t->aux))
+      {
+        bound = e;
+        e = e->left;
+      }
+    else
+      e = e->right;
+  return bound;
+}
+
+/* Returns the least element in T, or rb_end(T) if T is
+   empty. */
+struct rb_elem *
+rb_begin (struct rb_tree *t)
+{
+  return t->root != NULL ? leftmost (t->root) : NULL;
+}
+
+/* Returns the element after E in its tree, or the tree's
+   rb_end() if E is its greatest element. */
+struct rb_elem *
+rb_next (struct rb_elem *e)
+{
+  ASSERT (e != NULL);
+
+  if (e->right != NULL)
+    return leftmost (e->right);
+  while (e->parent != NULL && e == e->parent->right)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns T's end sentinel, a null pointer, which rb_next()
+   returns after the greatest element. */
+struct rb_elem *
+rb_end (struct rb_tree *t UNUSED)
+{
+  return NULL;
+}
+
+/* Returns the greatest element in T, or rb_rend(T) if T is
+   empty. */
+struct rb_elem *
+rb_rbegin (struct rb_tree *t)
+{
+  return t->root != NULL ? rightmost (t->root) : NULL;
+}
+
+/* Returns the element before E in its tree, or the tree's
+   rb_rend() if E is its least element. */
+struct rb_elem *
+rb_prev (struct rb_elem *e)
+{
+  ASSERT (e != NULL);
+
+  if (e->left != NULL)
+    return rightmost (e->left);
+  while (e->parent != NULL && e == e->parent->left)
+    e = e->parent;
+  return e->parent;
+}
+
+/* Returns T's reverse end sentinel, a null pointer, which
+   rb_prev() returns before the least element. */
+struct rb_elem *
+rb_rend (struct rb_tree *t UNUSED)
+{
+  return NULL;
+}
+
+/* Returns the number of elements in T. */
+size_t
+rb_size (struct rb_tree *t)
+{
+  return t->elem_cnt;
+}
+
+/* Returns true if T is empty, false otherwise. */
+bool
+rb_empty (struct rb_tree *t)
+{
+  return t->root == NULL;
+}
+
+/* Rotates the subtree rooted at X in T to the left, so that X's
+   right child takes its place. */
+static void
+rotate_left (struct rb_tree *t, struct rb_elem *x)
+{
+  struct rb_elem *y = x->right;
+
+  x->right = y->left;
+  if (y->left != NULL)
+    y->left->parent = x;
+  replace_child (t, x, y);
+  y->parent = x->parent;
+  y->left = x;
+  x->parent = y;
+}
+
+/* Rotates the subtree rooted at X in T to the right, so that X's
+   left child takes its place. */
+static void
+rotate_right (struct rb_tree *t, struct rb_elem *x)
+{
+  struct rb_elem *y = x->left;
+
+  x->left = y->right;
+  if (y->right != NULL)
+    y->right->parent = x;
+  replace_child (t, x, y);
+  y->parent = x->parent;
+  y->right = x;
+  x->parent = y;
+}
+
+/* Restores the red-black properties of T after inserting red
+   element E, whose parent may also be red. */
+static void
+insert_fixup (struct rb_tree *t, struct rb_elem *e)
+{
+  struct rb_elem *parent;
+
+  while ((parent = e->parent) != NULL && parent->red)
+    {
+      /* A red parent is never the root, so it has a parent. */
+      struct rb_elem *grandparent = parent->parent;
+
+      if (parent == grandparent->left)
+        {
+          struct rb_elem *uncle = grandparent->right;
+
+          if (uncle != NULL && uncle->red)
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              e = grandparent;
+              continue;
+            }
+          if (e == parent->right)
+            {
+              rotate_left (t, parent);
+              e = parent;
+              parent = e->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_right (t, grandparent);
+        }
+      else
+        {
+          struct rb_elem *uncle = grandparent->left;
+
+          if (uncle != NULL && uncle->red)
+            {
+              parent->red = uncle->red = false;
+              grandparent->red = true;
+              e = grandparent;
+              continue;
+            }
+          if (e == parent->left)
+            {
+              rotate_right (t, parent);
+              e = parent;
+              parent = e->parent;
+            }
+          parent->red = false;
+          grandparent->red = true;
+          rotate_left (t, grandparent);
+        }
+    }
+  t->root->red = false;
+}
+
+/* Returns true if E is a red element, false if it is black or
+   a null leaf. */
+static inline bool
+is_red (const struct rb_elem *e)
+{
+  return e != NULL && e->red;
+}
+
+/* Restores the red-black properties of T after removing a black
+   element.  E, which may be null, took the removed element's
+   place as a child of PARENT and is short one black element on
+   every path through it. */
+static void
+remove_fixup (struct rb_tree *t, struct rb_elem *e, struct rb_elem *parent)
+{
+  while (e != t->root && !is_red (e))
+    {
+      /* E is short a black element, so its sibling is not null. */
+      if (e == parent->left)
+        {
+          struct rb_elem *sibling = parent->right;
+
+          if (sibling->red)
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_left (t, parent);
+              sibling = parent->right;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              sibling->red = true;
+              e = parent;
+              parent = e->parent;
+              continue;
+            }
+          if (!is_red (sibling->right))
+            {
+              sibling->left->red = false;
+              sibling->red = true;
+              rotate_right (t, sibling);
+              sibling = parent->right;
+            }
+          sibling->red = parent->red;
+          parent->red = false;
+          sibling->right->red = false;
+          rotate_left (t, parent);
+        }
+      else
+        {
+          struct rb_elem *sibling = parent->left;
+
+          if (sibling->red)
+            {
+              sibling->red = false;
+              parent->red = true;
+              rotate_right (t, parent);
+              sibling = parent->left;
+            }
+          if (!is_red (sibling->left) && !is_red (sibling->right))
+            {
+              sibling->red = true;
+              e = parent;
+              parent = e->parent;
+              continue;
+            }
+          if (!is_red (sibling->left))
+            {
+              sibling->right->red = false;
+              sibling->red = true;
+              rotate_left (t, sibling);
+              sibling = parent->left;
+            }
+          sibling->red = parent->red;
+          parent->red = false;
+          sibling->left->red = false;
+          rotate_right (t, parent);
+        }
+      e = t->root;
+    }
+  if (e != NULL)
+    e->red = false;
+}
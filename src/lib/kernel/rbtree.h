@@ -0,0 +1,104 @@
+#ifndef __LIB_KERNEL_RBTREE_H
+#define __LIB_KERNEL_RBTREE_H
+
+/* Red-black tree.
+
+   A balanced binary search tree that keeps its elements sorted
+   and finds, inserts, or removes any of them in O(log n) time.
+   Use it instead of a list kept in order with
+   list_insert_ordered() when the list can grow long, or instead
+   of a hash table when elements must also be visited in order or
+   searched by range.
+
+   Like lists and hash tables, trees do not use dynamic
+   allocation.  Each structure that can potentially be in a tree
+   must embed a struct rb_elem member, and rb_entry() converts a
+   struct rb_elem back to the structure that contains it.  Refer
+   to lib/kernel/list.h for a detailed explanation.
+
+   The tree orders elements with a less-than function supplied
+   to rb_init().  Elements that compare equal may coexist; a new
+   one goes after those already present.  To look up by key, fill
+   in the key fields of a structure on the stack and pass its
+   rb_elem, as with hash_find().  For example, to visit every
+   `struct foo' with BAR in the range [LO, HI]:
+
+      struct foo lo, hi;
+      struct rb_elem *e, *end;
+
+      lo.bar = LO;
+      hi.bar = HI;
+      end = rb_upper_bound (&foo_tree, &hi.elem);
+      for (e = rb_lower_bound (&foo_tree, &lo.elem); e != end;
+           e = rb_next (e))
+        {
+          struct foo *f = rb_entry (e, struct foo, elem);
+          ...do something with f...
+        }
+
+   rb_end() is a null pointer, so the same loop works when no
+   element is greater than HI. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Tree element. */
+struct rb_elem
+  {
+    struct rb_elem *parent;     /* Parent, or null for the root. */
+    struct rb_elem *left;       /* Left child, with lesser elements. */
+    struct rb_elem *right;      /* Right child, with greater elements. */
+    bool red;                   /* Red (true) or black (false)? */
+  };
+
+/* Converts pointer to tree element RB_ELEM into a pointer to the
+   structure that RB_ELEM is embedded inside.  Supply the name of
+   the outer structure STRUCT and the member name MEMBER of the
+   tree element. */
+#define rb_entry(RB_ELEM, STRUCT, MEMBER)                       \
+        ((STRUCT *) ((uint8_t *) &(RB_ELEM)->parent             \
+                     - offsetof (STRUCT, MEMBER.parent)))
+
+/* Compares the value of two tree elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool rb_less_func (const struct rb_elem *a,
+                           const struct rb_elem *b,
+                           void *aux);
+
+/* Red-black tree. */
+struct rb_tree
+  {
+    struct rb_elem *root;       /* Root element, or null if empty. */
+    size_t elem_cnt;            /* Number of elements in tree. */
+    rb_less_func *less;         /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void rb_init (struct rb_tree *, rb_less_func *, void *aux);
+
+/* Insertion and removal. */
+void rb_insert (struct rb_tree *, struct rb_elem *);
+void rb_remove (struct rb_tree *, struct rb_elem *);
+
+/* Search. */
+struct rb_elem *rb_find (struct rb_tree *, const struct rb_elem *);
+struct rb_elem *rb_lower_bound (struct rb_tree *, const struct rb_elem *);
+struct rb_elem *rb_upper_bound (struct rb_tree *, const struct rb_elem *);
+
+/* Traversal, in ascending order. */
+struct rb_elem *rb_begin (struct rb_tree *);
+struct rb_elem *rb_next (struct rb_elem *);
+struct rb_elem *rb_end (struct rb_tree *);
+
+/* Traversal, in descending order. */
+struct rb_elem *rb_rbegin (struct rb_tree *);
+struct rb_elem *rb_prev (struct rb_elem *);
+struct rb_elem *rb_rend (struct rb_tree *);
+
+/* Properties. */
+size_t rb_size (struct rb_tree *);
+bool rb_empty (struct rb_tree *);
+
+#endif /* lib/kernel/rbtree.h */
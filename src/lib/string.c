@@ -1,5 +1,39 @@
 #include <string.h>
 #include <debug.h>
+#include <stdint.h>
+
+/* Blocks shorter than this many bytes are handled a byte at a
+   time, which is faster than setting up a string instruction. */
+#define WORD_MIN 16
+
+/* A 32-bit word that may alias any other type, for reading
+   memory a word at a time. */
+typedef uint32_t __attribute__ ((__may_alias__)) word_t;
+
+/* Copies SIZE bytes upward from SRC to DST, a word at a time
+   after aligning DST.  Safe for overlapping blocks if DST is
+   below SRC. */
+static void
+copy_up (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  if (size >= WORD_MIN)
+    {
+      size_t words;
+
+      while ((uintptr_t) dst % sizeof (word_t) != 0)
+        {
+          *dst++ = *src++;
+          size--;
+        }
+      words = size / sizeof (word_t);
+      size %= sizeof (word_t);
+      asm volatile ("rep movsl"
+                    : "+D" (dst), "+S" (src), "+c" (words)
+                    : : "memory");
+    }
+  while (size-- > 0)
+    *dst++ = *src++;
+}
 
 /* Copies SIZE bytes from SRC to DST, which must not overlap.
    Returns DST. */
@@ -12,9 +46,7 @@ memcpy (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  while (size-- > 0)
-    *dst++ = *src++;
-
+  copy_up (dst, src, size);
   return dst_;
 }
 
@@ -29,20 +61,31 @@ memmove (void *dst_, const void *src_, size_t size)
   ASSERT (dst != NULL || size == 0);
   ASSERT (src != NULL || size == 0);
 
-  if (dst < src) 
-    {
-      while (size-- > 0)
-        *dst++ = *src++;
-    }
+  if (dst < src || dst >= src + size) 
+    copy_up (dst, src, size);
   else 
     {
+      /* Copy downward, starting from the end, so that nothing is
+         overwritten before it is copied. */
       dst += size;
       src += size;
-      while (size-- > 0)
-        *--dst = *--src;
+      while (size % sizeof (word_t) != 0)
+        {
+          *--dst = *--src;
+          size--;
+        }
+      if (size > 0)
+        {
+          size_t words = size / sizeof (word_t);
+          dst -= sizeof (word_t);
+          src -= sizeof (word_t);
+          asm volatile ("std; rep movsl; cld"
+                        : "+D" (dst), "+S" (src), "+c" (words)
+                        : : "memory");
+        }
     }
 
-  return dst;
+  return dst_;
 }
 
 /* Find the first differing byte in the two blocks of SIZE bytes
@@ -58,6 +101,15 @@ memcmp (const void *a_, const void *b_, size_t size)
   ASSERT (a != NULL || size == 0);
   ASSERT (b != NULL || size == 0);
 
+  /* Skip over equal words, leaving the first differing byte, if
+     any, in the bytes that remain. */
+  for (; size >= sizeof (word_t); a += sizeof (word_t), b += sizeof (word_t))
+    {
+      if (*(const word_t *) a != *(const word_t *) b)
+        break;
+      size -= sizeof (word_t);
+    }
+
   for (; size-- > 0; a++, b++)
     if (*a != *b)
       return *a > *b ? +1 : -1;
@@ -281,7 +333,24 @@ memset (void *dst_, int value, size_t size)
   unsigned char *dst = dst_;
 
   ASSERT (dst != NULL || size == 0);
-  
+
+  if (size >= WORD_MIN)
+    {
+      uint32_t word = (unsigned char) value * 0x01010101u;
+      size_t words;
+
+      while ((uintptr_t) dst % sizeof (word_t) != 0)
+        {
+          *dst++ = value;
+          size--;
+        }
+      words = size / sizeof (word_t);
+      size %= sizeof (word_t);
+      asm volatile ("rep stosl"
+                    : "+D" (dst), "+c" (words)
+                    : "a" (word)
+                    : "memory");
+    }
   while (size-- > 0)
     *dst++ = value;
 
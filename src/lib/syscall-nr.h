@@ -28,7 +28,12 @@ enum
     SYS_MKDIR,                  /* Create a directory. */
     SYS_READDIR,                /* Reads a directory entry. */
     SYS_ISDIR,                  /* Tests if a fd represents a directory. */
-    SYS_INUMBER                 /* Returns the inode number for a fd. */
+    SYS_INUMBER,                /* Returns the inode number for a fd. */
+    SYS_RMTREE,                 /* Deletes a directory tree. */
+    SYS_READDIR_PLUS,           /* Reads directory entries with metadata. */
+
+    /* User memory allocation. */
+    SYS_SBRK                    /* Changes the size of the heap. */
   };
 
 #endif /* lib/syscall-nr.h */
@@ -3,6 +3,40 @@
 #include <syscall.h>
 #include <syscall-nr.h>
 
+/* Output to a file handle is collected in a stream's buffer and
+   written with a single system call when the buffer fills up,
+   when hflush() is called, or, for the console, at the end of
+   each line.  The system call wrappers in lib/user/syscall.c
+   flush a handle's stream before any other operation on it, and
+   exit(), exec(), and halt() flush every stream, so buffering
+   changes only the number of system calls, not what a program
+   writes or in what order. */
+
+/* Number of streams.  When all are in use, writing to another
+   handle flushes one and takes it over. */
+#define STREAM_CNT 8
+
+/* Size of each stream's buffer. */
+#define STREAM_BUF_SIZE 512
+
+/* A buffered output stream. */
+struct stream 
+  {
+    bool in_use;                /* Assigned to HANDLE? */
+    int handle;                 /* Output file handle. */
+    bool line_buffered;         /* Flush at each new-line? */
+    size_t len;                 /* Number of bytes in BUF. */
+    char buf[STREAM_BUF_SIZE];  /* Buffered output. */
+  };
+
+static struct stream streams[STREAM_CNT];
+static size_t next_victim;      /* Next stream to take over. */
+
+static struct stream *find_stream (int handle);
+static struct stream *get_stream (int handle);
+static void put_char (struct stream *, char);
+static void flush_stream (struct stream *);
+
 /* The standard vprintf() function,
    which is like printf() but uses a va_list. */
 int
@@ -30,8 +64,11 @@ hprintf (int handle, const char *format, ...)
 int
 puts (const char *s) 
 {
-  write (STDOUT_FILENO, s, strlen (s));
-  putchar ('\n');
+  struct stream *stream = get_stream (STDOUT_FILENO);
+
+  while (*s != '\0')
+    put_char (stream, *s++);
+  put_char (stream, '\n');
 
   return 0;
 }
@@ -40,22 +77,18 @@ puts (const char *s)
 int
 putchar (int c) 
 {
-  char c2 = c;
-  write (STDOUT_FILENO, &c2, 1);
+  put_char (get_stream (STDOUT_FILENO), c);
   return c;
 }
 
 /* Auxiliary data for vhprintf_helper(). */
 struct vhprintf_aux 
   {
-    char buf[64];       /* Character buffer. */
-    char *p;            /* Current position in buffer. */
-    int char_cnt;       /* Total characters written so far. */
-    int handle;         /* Output file handle. */
+    struct stream *stream;      /* Output stream. */
+    int char_cnt;               /* Total characters written so far. */
   };
 
 static void add_char (char, void *);
-static void flush (struct vhprintf_aux *);
 
 /* Formats the printf() format specification FORMAT with
    arguments given in ARGS and writes the output to the given
@@ -64,31 +97,108 @@ int
 vhprintf (int handle, const char *format, va_list args) 
 {
   struct vhprintf_aux aux;
-  aux.p = aux.buf;
+  aux.stream = get_stream (handle);
   aux.char_cnt = 0;
-  aux.handle = handle;
   __vprintf (format, args, add_char, &aux);
-  flush (&aux);
   return aux.char_cnt;
 }
 
-/* Adds C to the buffer in AUX, flushing it if the buffer fills
-   up. */
+/* Adds C to the stream in AUX. */
 static void
 add_char (char c, void *aux_) 
 {
   struct vhprintf_aux *aux = aux_;
-  *aux->p++ = c;
-  if (aux->p >= aux->buf + sizeof aux->buf)
-    flush (aux);
+  put_char (aux->stream, c);
   aux->char_cnt++;
 }
 
-/* Flushes the buffer in AUX. */
+/* Writes out any output buffered for HANDLE. */
+void
+hflush (int handle) 
+{
+  struct stream *stream = find_stream (handle);
+  if (stream != NULL)
+    flush_stream (stream);
+}
+
+/* Writes out the output buffered for every handle. */
+void
+hflush_all (void) 
+{
+  size_t i;
+
+  for (i = 0; i < STREAM_CNT; i++)
+    if (streams[i].in_use)
+      flush_stream (&streams[i]);
+}
+
+/* Returns the stream for HANDLE, or a null pointer if it has
+   none. */
+static struct stream *
+find_stream (int handle) 
+{
+  size_t i;
+
+  for (i = 0; i < STREAM_CNT; i++)
+    if (streams[i].in_use && streams[i].handle == handle)
+      return &streams[i];
+  return NULL;
+}
+
+/* Returns the stream for HANDLE, assigning it one if it has
+   none.  The console is line buffered, other handles fully
+   buffered. */
+static struct stream *
+get_stream (int handle) 
+{
+  struct stream *stream = find_stream (handle);
+  size_t i;
+
+  if (stream != NULL)
+    return stream;
+
+  /* Use a free stream if there is one, otherwise take one
+     over. */
+  for (i = 0; i < STREAM_CNT; i++)
+    if (!streams[i].in_use)
+      {
+        stream = &streams[i];
+        break;
+      }
+  if (stream == NULL)
+    {
+      stream = &streams[next_victim];
+      next_victim = (next_victim + 1) % STREAM_CNT;
+      flush_stream (stream);
+    }
+
+  stream->in_use = true;
+  stream->handle = handle;
+  stream->line_buffered = handle == STDOUT_FILENO;
+  stream->len = 0;
+  return stream;
+}
+
+/* Adds C to STREAM, flushing it if its buffer fills up or, for
+   a line-buffered stream, if C ends a line. */
 static void
-flush (struct vhprintf_aux *aux)
+put_char (struct stream *stream, char c) 
 {
-  if (aux->p > aux->buf)
-    write (aux->handle, aux->buf, aux->p - aux->buf);
-  aux->p = aux->buf;
+  stream->buf[stream->len++] = c;
+  if (stream->len >= sizeof stream->buf
+      || (stream->line_buffered && c == '\n'))
+    flush_stream (stream);
+}
+
+/* Writes out the output buffered in STREAM. */
+static void
+flush_stream (struct stream *stream)
+{
+  size_t len = stream->len;
+
+  /* Empty the buffer first, because write() flushes the stream
+     before writing. */
+  stream->len = 0;
+  if (len > 0)
+    write (stream->handle, stream->buf, len);
 }
@@ -0,0 +1,329 @@
+#include <stdlib.h>
+#include <debug.h>
+#include <round.h>
+#include <stdint.h>
+#include <string.h>
+#include <syscall.h>
+
+/* User-space malloc().
+
+   Memory comes from the process's heap, which grows and shrinks
+   with sbrk().  Every block begins with a header that records
+   its size, header included, so that free() knows what kind of
+   block it has.
+
+   A small request, one whose block with its header fits in
+   2 kB, is rounded up to a power of 2 and assigned to the size
+   class for blocks of that size, 16 bytes or more.  Each class
+   keeps a list of free blocks.  If a class's free list is empty,
+   we take a 4 kB chunk from the large-block allocator below,
+   divide it into blocks, and add them all to the free list.
+   Freed small blocks go back on their class's free list; they
+   are not returned to the heap.
+
+   A large request is rounded up to a multiple of 16 bytes and
+   satisfied from a list of free large blocks, kept in address
+   order, taking the first one that is big enough and splitting
+   off whatever is left over if that is big enough to be a large
+   block itself.  If no free block is big enough, we grow the
+   heap, extending the last free block instead if it is at the
+   top of the heap.  When we free a large block, we merge it
+   with any free neighbors, and once the free block at the top
+   of the heap reaches 64 kB we shrink the heap to give it
+   back. */
+
+/* Magic number for detecting heap corruption. */
+#define BLOCK_MAGIC 0x5ab1e7c5
+
+/* Block sizes, headers included. */
+#define MIN_BLOCK 16                    /* Smallest block. */
+#define MAX_SMALL 2048                  /* Largest small block. */
+#define CLASS_CNT 8                     /* Classes, MIN_BLOCK...MAX_SMALL. */
+#define CHUNK_SIZE 4096                 /* Divided into small blocks. */
+#define TRIM_SIZE (64 * 1024)           /* Free top block to give back. */
+
+/* Block header. */
+struct header
+  {
+    unsigned magic;             /* BLOCK_MAGIC while in use. */
+    size_t size;                /* Size of block, header included. */
+  };
+
+/* Free block. */
+struct block
+  {
+    struct header header;       /* Header. */
+    struct block *next;         /* Next free block. */
+  };
+
+static struct block *small_free[CLASS_CNT];     /* Free small blocks. */
+static struct block *large_free;                /* Free large blocks. */
+
+static bool refill (size_t class);
+static struct block *large_alloc (size_t size);
+static void large_release (struct block *);
+
+/* Returns the class of small blocks of SIZE bytes. */
+static size_t
+size_class (size_t size)
+{
+  size_t class = 0;
+
+  while ((size_t) MIN_BLOCK << class < size)
+    class++;
+  return class;
+}
+
+/* Returns the address just past block B. */
+static void *
+block_end (struct block *b)
+{
+  return (uint8_t *) b + b->header.size;
+}
+
+/* Returns the block whose usable memory starts at P. */
+static struct block *
+ptr_to_block (void *p)
+{
+  struct block *b = (struct block *) ((uint8_t *) p - sizeof (struct header));
+
+  ASSERT (b->header.magic == BLOCK_MAGIC);
+  return b;
+}
+
+/* Obtains and returns a new block of at least SIZE bytes.
+   Returns a null pointer if SIZE is zero or if memory is not
+   available. */
+void *
+malloc (size_t size)
+{
+  struct block *b;
+  size_t total;
+
+  /* A null pointer satisfies a request for 0 bytes. */
+  if (size == 0 || size > SIZE_MAX / 2)
+    return NULL;
+
+  total = size + sizeof (struct header);
+  if (total <= MAX_SMALL)
+    {
+      size_t class = size_class (total);
+
+      if (small_free[class] == NULL && !refill (class))
+        return NULL;
+      b = small_free[class];
+      small_free[class] = b->next;
+    }
+  else
+    {
+      b = large_alloc (ROUND_UP (total, MIN_BLOCK));
+      if (b == NULL)
+        return NULL;
+    }
+
+  b->header.magic = BLOCK_MAGIC;
+  return (uint8_t *) b + sizeof (struct header);
+}
+
+/* Allocates and return A times B bytes initialized to zeroes.
+   Returns a null pointer if memory is not available. */
+void *
+calloc (size_t a, size_t b)
+{
+  void *p;
+  size_t size;
+
+  /* Calculate block size and make sure it fits in size_t. */
+  if (b != 0 && a > SIZE_MAX / b)
+    return NULL;
+  size = a * b;
+
+  /* Allocate and zero memory. */
+  p = malloc (size);
+  if (p != NULL)
+    memset (p, 0, size);
+
+  return p;
+}
+
+/* Attempts to resize OLD_BLOCK to NEW_SIZE bytes, possibly
+   moving it in the process.
+   If successful, returns the new block; on failure, returns a
+   null pointer.
+   A call with null OLD_BLOCK is equivalent to malloc(NEW_SIZE).
+   A call with zero NEW_SIZE is equivalent to free(OLD_BLOCK). */
+void *
+realloc (void *old_block, size_t new_size)
+{
+  if (new_size == 0)
+    {
+      free (old_block);
+      return NULL;
+    }
+  else if (old_block == NULL)
+    return malloc (new_size);
+  else
+    {
+      struct block *b = ptr_to_block (old_block);
+      size_t old_size = b->header.size - sizeof (struct header);
+      void *new_block;
+
+      /* The block may already have room. */
+      if (new_size <= old_size)
+        return old_block;
+
+      new_block = malloc (new_size);
+      if (new_block != NULL)
+        {
+          memcpy (new_block, old_block, old_size);
+          free (old_block);
+        }
+      return new_block;
+    }
+}
+
+/* Frees block P, which must have been previously allocated with
+   malloc(), calloc(), or realloc(). */
+void
+free (void *p)
+{
+  struct block *b;
+
+  if (p == NULL)
+    return;
+
+  b = ptr_to_block (p);
+  b->header.magic = 0;
+  if (b->header.size <= MAX_SMALL)
+    {
+      size_t class = size_class (b->header.size);
+
+      b->next = small_free[class];
+      small_free[class] = b;
+    }
+  else
+    large_release (b);
+}
+
+/* Divides a new chunk into blocks of size class CLASS and adds
+   them to its free list.  Returns true if successful, false if
+   memory is not available. */
+static bool
+refill (size_t class)
+{
+  size_t block_size = (size_t) MIN_BLOCK << class;
+  struct block *chunk = large_alloc (CHUNK_SIZE);
+  size_t i;
+
+  if (chunk == NULL)
+    return false;
+
+  /* Add blocks in reverse, so that they come off the list in
+     address order. */
+  for (i = chunk->header.size / block_size; i-- > 0; )
+    {
+      struct block *b = (struct block *) ((uint8_t *) chunk
+                                          + i * block_size);
+      b->header.size = block_size;
+      b->next = small_free[class];
+      small_free[class] = b;
+    }
+  return true;
+}
+
+/* Returns a large block of at least SIZE bytes, a multiple of
+   MIN_BLOCK greater than MAX_SMALL, taken from the free list or
+   from new heap space.  Returns a null pointer if memory is not
+   available. */
+static struct block *
+large_alloc (size_t size)
+{
+  struct block **link, **last_link = NULL;
+  struct block *b;
+
+  ASSERT (size > MAX_SMALL && size % MIN_BLOCK == 0);
+
+  /* Take the first free block that is big enough. */
+  for (link = &large_free; (b = *link) != NULL; link = &b->next)
+    {
+      if (b->header.size >= size)
+        {
+          if (b->header.size - size > MAX_SMALL)
+            {
+              /* Leave the excess on the free list in B's place. */
+              struct block *rest = (struct block *) ((uint8_t *) b + size);
+              rest->header.size = b->header.size - size;
+              rest->next = b->next;
+              *link = rest;
+              b->header.size = size;
+            }
+          else
+            *link = b->next;
+          return b;
+        }
+      last_link = link;
+    }
+
+  /* Extend the last free block if it is at the top of the
+     heap. */
+  if (last_link != NULL && block_end (*last_link) == sbrk (0))
+    {
+      b = *last_link;
+      if (sbrk (size - b->header.size) == (void *) -1)
+        return NULL;
+      *last_link = NULL;
+      b->header.size = size;
+      return b;
+    }
+
+  /* Otherwise grow the heap by a whole block. */
+  b = sbrk (size);
+  if (b == (void *) -1)
+    return NULL;
+  b->header.size = size;
+  return b;
+}
+
+/* Adds large block B to the free list, merging it with free
+   neighbors, and shrinks the heap if that leaves enough free
+   space at its top. */
+static void
+large_release (struct block *b)
+{
+  struct block **link, **prev_link = NULL;
+  struct block *prev = NULL;
+
+  /* Find B's place in address order. */
+  for (link = &large_free; *link != NULL && *link < b;
+       link = &(*link)->next)
+    {
+      prev_link = link;
+      prev = *link;
+    }
+
+  /* Insert B, merging it with the next block, then merge it into
+     the previous block. */
+  b->next = *link;
+  if (b->next != NULL && block_end (b) == b->next)
+    {
+      b->header.size += b->next->header.size;
+      b->next = b->next->next;
+    }
+  if (prev != NULL && block_end (prev) == b)
+    {
+      prev->header.size += b->header.size;
+      prev->next = b->next;
+      b = prev;
+      link = prev_link;
+    }
+  else
+    *link = b;
+
+  /* Give back a big enough free block at the top of the heap. */
+  if (b->next == NULL && b->header.size >= TRIM_SIZE
+      && block_end (b) == sbrk (0))
+    {
+      *link = NULL;
+      sbrk (-(intptr_t) b->header.size);
+    }
+}
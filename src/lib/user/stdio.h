@@ -4,4 +4,8 @@
 int hprintf (int, const char *, ...) PRINTF_FORMAT (2, 3);
 int vhprintf (int, const char *, va_list) PRINTF_FORMAT (2, 0);
 
+/* Buffered output. */
+void hflush (int);
+void hflush_all (void);
+
 #endif /* lib/user/stdio.h */
@@ -1,4 +1,5 @@
 #include <syscall.h>
+#include <stdio.h>
 #include "../syscall-nr.h"
 
 /* Invokes syscall NUMBER, passing no arguments, and returns the
@@ -64,6 +65,7 @@
 void
 halt (void) 
 {
+  hflush_all ();
   syscall0 (SYS_HALT);
   NOT_REACHED ();
 }
@@ -71,6 +73,7 @@ halt (void)
 void
 exit (int status)
 {
+  hflush_all ();
   syscall1 (SYS_EXIT, status);
   NOT_REACHED ();
 }
@@ -78,6 +81,7 @@ exit (int status)
 pid_t
 exec (const char *file)
 {
+  hflush_all ();
   return (pid_t) syscall1 (SYS_EXEC, file);
 }
 
@@ -108,42 +112,50 @@ open (const char *file)
 int
 filesize (int fd) 
 {
+  hflush (fd);
   return syscall1 (SYS_FILESIZE, fd);
 }
 
 int
 read (int fd, void *buffer, unsigned size)
 {
+  /* Show any prompt before waiting for input. */
+  hflush (fd == STDIN_FILENO ? STDOUT_FILENO : fd);
   return syscall3 (SYS_READ, fd, buffer, size);
 }
 
 int
 write (int fd, const void *buffer, unsigned size)
 {
+  hflush (fd);
   return syscall3 (SYS_WRITE, fd, buffer, size);
 }
 
 void
 seek (int fd, unsigned position) 
 {
+  hflush (fd);
   syscall2 (SYS_SEEK, fd, position);
 }
 
 unsigned
 tell (int fd) 
 {
+  hflush (fd);
   return syscall1 (SYS_TELL, fd);
 }
 
 void
 close (int fd)
 {
+  hflush (fd);
   syscall1 (SYS_CLOSE, fd);
 }
 
 mapid_t
 mmap (int fd, void *addr)
 {
+  hflush (fd);
   return syscall2 (SYS_MMAP, fd, addr);
 }
 
@@ -182,3 +194,21 @@ inumber (int fd)
 {
   return syscall1 (SYS_INUMBER, fd);
 }
+
+bool
+rmtree (const char *dir)
+{
+  return syscall1 (SYS_RMTREE, dir);
+}
+
+int
+readdir_plus (int fd, struct dirent_plus *entries, unsigned cnt)
+{
+  return syscall3 (SYS_READDIR_PLUS, fd, entries, cnt);
+}
+
+void *
+sbrk (intptr_t increment)
+{
+  return (void *) syscall1 (SYS_SBRK, increment);
+}
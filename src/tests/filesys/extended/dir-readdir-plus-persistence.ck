@@ -0,0 +1,6 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_archive ({"d" => {"a" => {}, "b" => ["\0" x 1234], "c" => ['']}});
+pass;
@@ -0,0 +1,53 @@
+/* Reads a directory's entries with readdir_plus() and checks
+   each entry's metadata against what open() reports for it. */
+
+#include <stdio.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+static void
+check_entry (const struct dirent_plus *e, const char *name) 
+{
+  char path[32];
+  int fd;
+
+  CHECK (!strcmp (e->name, name),
+         "entry \"%s\" (actually \"%s\")", name, e->name);
+  snprintf (path, sizeof path, "d/%s", name);
+  CHECK ((fd = open (path)) > 1, "open \"%s\"", path);
+  CHECK (e->inumber == inumber (fd), "inumber of \"%s\" matches", path);
+  CHECK (e->isdir == isdir (fd), "type of \"%s\" matches", path);
+  if (!e->isdir)
+    CHECK (e->length == filesize (fd), "size of \"%s\" matches", path);
+  msg ("close \"%s\"", path);
+  close (fd);
+}
+
+void
+test_main (void) 
+{
+  struct dirent_plus entries[2];
+  int fd, cnt;
+
+  CHECK (mkdir ("d"), "mkdir \"d\"");
+  CHECK (mkdir ("d/a"), "mkdir \"d/a\"");
+  CHECK (create ("d/b", 1234), "create \"d/b\"");
+  CHECK (create ("d/c", 0), "create \"d/c\"");
+  CHECK ((fd = open ("d")) > 1, "open \"d\"");
+
+  cnt = readdir_plus (fd, entries, 2);
+  CHECK (cnt == 2, "readdir_plus \"d\" (must return 2, actually %d)", cnt);
+  check_entry (&entries[0], "a");
+  check_entry (&entries[1], "b");
+
+  cnt = readdir_plus (fd, entries, 2);
+  CHECK (cnt == 1, "readdir_plus \"d\" (must return 1, actually %d)", cnt);
+  check_entry (&entries[0], "c");
+
+  cnt = readdir_plus (fd, entries, 2);
+  CHECK (cnt == 0, "readdir_plus \"d\" (must return 0, actually %d)", cnt);
+  msg ("close \"d\"");
+  close (fd);
+}
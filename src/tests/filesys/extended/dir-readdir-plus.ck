@@ -0,0 +1,35 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-readdir-plus) begin
+(dir-readdir-plus) mkdir "d"
+(dir-readdir-plus) mkdir "d/a"
+(dir-readdir-plus) create "d/b"
+(dir-readdir-plus) create "d/c"
+(dir-readdir-plus) open "d"
+(dir-readdir-plus) readdir_plus "d" (must return 2, actually 2)
+(dir-readdir-plus) entry "a" (actually "a")
+(dir-readdir-plus) open "d/a"
+(dir-readdir-plus) inumber of "d/a" matches
+(dir-readdir-plus) type of "d/a" matches
+(dir-readdir-plus) close "d/a"
+(dir-readdir-plus) entry "b" (actually "b")
+(dir-readdir-plus) open "d/b"
+(dir-readdir-plus) inumber of "d/b" matches
+(dir-readdir-plus) type of "d/b" matches
+(dir-readdir-plus) size of "d/b" matches
+(dir-readdir-plus) close "d/b"
+(dir-readdir-plus) readdir_plus "d" (must return 1, actually 1)
+(dir-readdir-plus) entry "c" (actually "c")
+(dir-readdir-plus) open "d/c"
+(dir-readdir-plus) inumber of "d/c" matches
+(dir-readdir-plus) type of "d/c" matches
+(dir-readdir-plus) size of "d/c" matches
+(dir-readdir-plus) close "d/c"
+(dir-readdir-plus) readdir_plus "d" (must return 0, actually 0)
+(dir-readdir-plus) close "d"
+(dir-readdir-plus) end
+EOF
+pass;
@@ -0,0 +1,23 @@
+/* Creates directories /0/0/0 through /3/2/2 and files in the
+   leaf directories, then removes each top-level directory with a
+   single rmtree() call. */
+
+#include <syscall.h>
+#include "tests/filesys/extended/mk-tree.h"
+#include "tests/lib.h"
+#include "tests/main.h"
+
+void
+test_main (void) 
+{
+  make_tree (4, 3, 3, 4);
+  CHECK (rmtree ("/0/1"), "rmtree \"/0/1\"");
+  CHECK (open ("/0/1/2/3") == -1, "open \"/0/1/2/3\" (must return -1)");
+  CHECK (rmtree ("/0/2/2/3"), "rmtree \"/0/2/2/3\"");
+  CHECK (rmtree ("/0"), "rmtree \"/0\"");
+  CHECK (rmtree ("/1"), "rmtree \"/1\"");
+  CHECK (rmtree ("/2"), "rmtree \"/2\"");
+  CHECK (rmtree ("/3"), "rmtree \"/3\"");
+  CHECK (!rmtree ("/3"), "rmtree \"/3\" again (must return false)");
+  CHECK (open ("/3/0/2/0") == -1, "open \"/3/0/2/0\" (must return -1)");
+}
@@ -0,0 +1,21 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(dir-rmtree) begin
+(dir-rmtree) creating /0/0/0/0 through /3/2/2/3...
+(dir-rmtree) open "/0/2/0/3"
+(dir-rmtree) close "/0/2/0/3"
+(dir-rmtree) rmtree "/0/1"
+(dir-rmtree) open "/0/1/2/3" (must return -1)
+(dir-rmtree) rmtree "/0/2/2/3"
+(dir-rmtree) rmtree "/0"
+(dir-rmtree) rmtree "/1"
+(dir-rmtree) rmtree "/2"
+(dir-rmtree) rmtree "/3"
+(dir-rmtree) rmtree "/3" again (must return false)
+(dir-rmtree) open "/3/0/2/0" (must return -1)
+(dir-rmtree) end
+EOF
+pass;
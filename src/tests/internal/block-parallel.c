@@ -0,0 +1,152 @@
+/* Test program for parallel I/O in devices/block.c.
+
+   Streams data to a file on the file system device and to the
+   swap device, first one at a time and then both at once from
+   two threads.  The file system and swap disks sit on different
+   IDE channels, so the simultaneous run should take noticeably
+   less time than the two sequential runs together.  Timings
+   depend on the host, so the test only reports them and leaves
+   the comparison to the reader.
+
+   If there is no swap device, the scratch device stands in for
+   it.  Either way, the first STREAM_SECTORS sectors of the device
+   are overwritten without warning, so don't run this with a
+   scratch disk whose contents matter.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/block.h"
+#include "devices/timer.h"
+#include "filesys/file.h"
+#include "filesys/filesys.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/test.h"
+
+/* Number of sectors streamed to each device. */
+#define STREAM_SECTORS 512
+
+/* A stream, run by its own thread. */
+struct stream
+  {
+    void (*function) (struct stream *);  /* Streams the data. */
+    struct block *block;                 /* Raw device, if any. */
+    int64_t ticks;                       /* Time taken. */
+    struct semaphore done;               /* Up'd when finished. */
+  };
+
+static void stream_to_file (struct stream *);
+static void stream_to_device (struct stream *);
+static void run_streams (struct stream *, size_t cnt);
+
+/* Test parallel I/O across IDE channels. */
+void
+test (void)
+{
+  struct stream fs, swap, both[2];
+  int64_t sequential, parallel;
+  struct block *swap_block;
+
+  swap_block = block_get_role (BLOCK_SWAP);
+  if (swap_block == NULL)
+    swap_block = block_get_role (BLOCK_SCRATCH);
+  ASSERT (swap_block != NULL);
+  ASSERT (block_size (swap_block) >= STREAM_SECTORS);
+
+  fs.function = stream_to_file;
+  fs.block = NULL;
+  swap.function = stream_to_device;
+  swap.block = swap_block;
+  both[0] = fs;
+  both[1] = swap;
+
+  run_streams (&fs, 1);
+  run_streams (&swap, 1);
+  run_streams (both, 2);
+
+  sequential = fs.ticks + swap.ticks;
+  parallel = both[0].ticks > both[1].ticks ? both[0].ticks : both[1].ticks;
+  printf ("filesys alone: %"PRId64" ticks\n", fs.ticks);
+  printf ("%s alone: %"PRId64" ticks\n", block_name (swap_block), swap.ticks);
+  printf ("both at once: %"PRId64" ticks, vs. %"PRId64" one at a time\n",
+          parallel, sequential);
+  printf ("block-parallel: PASS\n");
+}
+
+/* Thread function for stream S_. */
+static void
+stream_thread (void *s_)
+{
+  struct stream *s = s_;
+  int64_t start = timer_ticks ();
+
+  s->function (s);
+  s->ticks = timer_elapsed (start);
+  sema_up (&s->done);
+}
+
+/* Runs the CNT streams in S[] in parallel and waits for all of
+   them to finish. */
+static void
+run_streams (struct stream *s, size_t cnt)
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    {
+      sema_init (&s[i].done, 0);
+      thread_create ("stream", PRI_DEFAULT, stream_thread, &s[i]);
+    }
+  for (i = 0; i < cnt; i++)
+    sema_down (&s[i].done);
+}
+
+/* Writes STREAM_SECTORS sectors to a new file. */
+static void
+stream_to_file (struct stream *s UNUSED)
+{
+  static char buf[BLOCK_SECTOR_SIZE];
+  struct file *file;
+  int i;
+
+  filesys_remove ("stream");
+  ASSERT (filesys_create ("stream", 0));
+  file = filesys_open ("stream");
+  ASSERT (file != NULL);
+  memset (buf, 0x5a, sizeof buf);
+  for (i = 0; i < STREAM_SECTORS; i++)
+    ASSERT (file_write (file, buf, sizeof buf) == sizeof buf);
+  file_close (file);
+  ASSERT (filesys_remove ("stream"));
+}
+
+/* Writes STREAM_SECTORS sectors to S's block device, keeping a
+   few writes in flight at a time. */
+static void
+stream_to_device (struct stream *s)
+{
+  enum { DEPTH = 4 };
+  struct block_request *req[DEPTH];
+  char *buf;
+  int i;
+
+  buf = malloc (BLOCK_SECTOR_SIZE);
+  ASSERT (buf != NULL);
+  memset (buf, 0xa5, BLOCK_SECTOR_SIZE);
+  for (i = 0; i < STREAM_SECTORS; i++)
+    {
+      if (i >= DEPTH)
+        block_wait (req[i % DEPTH]);
+      req[i % DEPTH] = block_write_async (s->block, i, buf);
+    }
+  for (i = STREAM_SECTORS - DEPTH; i < STREAM_SECTORS; i++)
+    block_wait (req[i % DEPTH]);
+  free (buf);
+}
@@ -0,0 +1,395 @@
+/* Test program and benchmark for the hash functions and the
+   open-addressing hash table in lib/kernel/hash.c.
+
+   Checks hash_bytes_seed() against published MurmurHash3 test
+   vectors, and checks struct ohash against a simple model while
+   inserting, replacing, and deleting elements at random, so that
+   the table grows and shrinks many times over.  Then compares
+   the speed of hash_bytes(), hash_string(), and hash_int() with
+   the byte-at-a-time FNV-1 hash they replaced, and how evenly
+   each spreads consecutive integers over a power-of-2 number of
+   buckets.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <hash.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/test.h"
+
+/* Bytes hashed for each key size in the benchmark. */
+#define BENCH_BYTES (4 * 1024 * 1024)
+
+/* Buckets and keys for the distribution check. */
+#define BUCKET_CNT 256
+#define KEY_CNT (BUCKET_CNT * 16)
+
+static void check_vectors (void);
+static void check_ohash (void *aux);
+static void bench_bytes (void);
+static void bench_int (void);
+static void check_spread (void);
+
+void
+test (void)
+{
+  check_vectors ();
+  check_ohash (NULL);
+  check_ohash (&check_ohash);
+  printf ("hash: PASS\n");
+  bench_bytes ();
+  bench_int ();
+  check_spread ();
+}
+
+/* Fowler-Noll-Vo 32-bit hash constants. */
+#define FNV_32_PRIME 16777619u
+#define FNV_32_BASIS 2166136261u
+
+/* The FNV-1 hash of the SIZE bytes in BUF, for comparison. */
+static unsigned
+fnv_bytes (const void *buf_, size_t size)
+{
+  const unsigned char *buf = buf_;
+  unsigned hash = FNV_32_BASIS;
+
+  while (size-- > 0)
+    hash = (hash * FNV_32_PRIME) ^ *buf++;
+  return hash;
+}
+
+/* The FNV-1 hash of integer I, for comparison. */
+static unsigned
+fnv_int (int i)
+{
+  return fnv_bytes (&i, sizeof i);
+}
+
+/* A MurmurHash3 test vector. */
+struct vector
+  {
+    const char *s;
+    unsigned seed;
+    unsigned hash;
+  };
+
+static const struct vector vectors[] =
+  {
+    {"", 0, 0},
+    {"", 1, 0x514e28b7},
+    {"", 0xffffffff, 0x81f16f39},
+    {"aaaa", 0x9747b28c, 0x5a97808a},
+    {"abc", 0, 0xb3dd93fa},
+    {"Hello, world!", 0x9747b28c, 0x24884cba},
+    {"The quick brown fox jumps over the lazy dog", 0x9747b28c, 0x2fa826cd},
+  };
+
+/* Checks the seeded hash functions against VECTORS, and the
+   unseeded ones against them with a seed of 0. */
+static void
+check_vectors (void)
+{
+  static const char zeros[4];
+  size_t i;
+
+  for (i = 0; i < sizeof vectors / sizeof *vectors; i++)
+    {
+      const struct vector *v = &vectors[i];
+
+      ASSERT (hash_string_seed (v->s, v->seed) == v->hash);
+      ASSERT (hash_bytes_seed (v->s, strlen (v->s), v->seed) == v->hash);
+      ASSERT (hash_string (v->s) == hash_string_seed (v->s, 0));
+    }
+  ASSERT (hash_bytes (zeros, sizeof zeros) == 0x2362f9de);
+  ASSERT (hash_string_seed ("abc", 1) != hash_string_seed ("abc", 2));
+}
+
+/* Keys in the ohash check are drawn from 0...OKEY_CNT - 1. */
+#define OKEY_CNT 512
+
+/* There are more values than keys, so that a value can replace
+   another with the same key. */
+#define OVALUE_CNT (OKEY_CNT * 2)
+
+/* An element of the ohash check. */
+struct ovalue
+  {
+    struct hash_elem elem;      /* Hash table element. */
+    int key;                    /* Key. */
+    bool in_table;              /* Currently in the table? */
+    unsigned seen;              /* Last iteration that found it. */
+  };
+
+static struct ovalue ovalues[OVALUE_CNT];
+
+/* The value in the table with each key, or null. */
+static struct ovalue *by_key[OKEY_CNT];
+
+/* Hashes an ovalue's key.  If AUX is non-null, eight keys in a
+   row share each hash value, making long runs of occupied slots
+   for the probing and deletion code to get through. */
+static unsigned
+ovalue_hash (const struct hash_elem *e, void *aux)
+{
+  int key = hash_entry (e, struct ovalue, elem)->key;
+  return aux != NULL ? hash_int (key / 8) : hash_int (key);
+}
+
+/* Returns true if ovalue A's key is less than B's. */
+static bool
+ovalue_less (const struct hash_elem *a, const struct hash_elem *b,
+             void *aux UNUSED)
+{
+  return (hash_entry (a, struct ovalue, elem)->key
+          < hash_entry (b, struct ovalue, elem)->key);
+}
+
+/* Checks that H holds exactly the CNT values in BY_KEY, by
+   lookup and by iteration. */
+static void
+verify_ohash (struct ohash *h, size_t cnt)
+{
+  static unsigned iteration;
+  struct ohash_iterator i;
+  struct ovalue probe;
+  size_t found = 0;
+  int key;
+
+  ASSERT (ohash_size (h) == cnt);
+  ASSERT (ohash_empty (h) == (cnt == 0));
+
+  iteration++;
+  ohash_first (&i, h);
+  while (ohash_next (&i))
+    {
+      struct ovalue *v = hash_entry (ohash_cur (&i), struct ovalue, elem);
+      ASSERT (v->in_table && by_key[v->key] == v);
+      ASSERT (v->seen != iteration);
+      v->seen = iteration;
+      found++;
+    }
+  ASSERT (found == cnt);
+
+  for (key = 0; key < OKEY_CNT; key++)
+    {
+      struct hash_elem *e;
+
+      probe.key = key;
+      e = ohash_find (h, &probe.elem);
+      ASSERT (by_key[key] == NULL
+              ? e == NULL : e == &by_key[key]->elem);
+    }
+}
+
+/* Inserts, replaces, and deletes elements of an ohash at random,
+   passing AUX to its hash function, and checks the table after
+   every few steps.  Alternate rounds mostly insert and mostly delete,
+   so the table keeps growing and shrinking, and the check
+   insists on deletions and replacements of elements still in
+   the old slots while it does. */
+static void
+check_ohash (void *aux)
+{
+  struct ohash h;
+  size_t cnt = 0;
+  int moving_deletes[2] = {0, 0}, moving_replaces[2] = {0, 0};
+  int round, i;
+
+  memset (ovalues, 0, sizeof ovalues);
+  memset (by_key, 0, sizeof by_key);
+  ASSERT (ohash_init (&h, ovalue_hash, ovalue_less, aux));
+
+  for (round = 0; round < 8; round++)
+    for (i = 0; i < OKEY_CNT * 4; i++)
+      {
+        unsigned insert_pct = round % 2 == 0 ? 90 : 10;
+        int key = random_ulong () % OKEY_CNT;
+        bool moving = h.old_slots != NULL;
+        int growing = h.slot_cnt > h.old_slot_cnt;
+        struct ovalue probe;
+
+        probe.key = key;
+        if (random_ulong () % 100 < insert_pct)
+          {
+            struct ovalue *v = &ovalues[random_ulong () % OVALUE_CNT];
+            struct ovalue *old = by_key[key];
+            struct hash_elem *e;
+
+            if (v->in_table)
+              continue;
+            v->key = key;
+            if (random_ulong () % 2)
+              {
+                e = ohash_insert (&h, &v->elem);
+                ASSERT (old == NULL ? e == NULL : e == &old->elem);
+                if (old != NULL)
+                  continue;
+              }
+            else
+              {
+                e = ohash_replace (&h, &v->elem);
+                ASSERT (old == NULL ? e == NULL : e == &old->elem);
+                if (old != NULL)
+                  {
+                    old->in_table = false;
+                    cnt--;
+                    if (moving)
+                      moving_replaces[growing]++;
+                  }
+              }
+            v->in_table = true;
+            by_key[key] = v;
+            cnt++;
+          }
+        else
+          {
+            struct ovalue *old = by_key[key];
+            struct hash_elem *e = ohash_delete (&h, &probe.elem);
+
+            ASSERT (old == NULL ? e == NULL : e == &old->elem);
+            if (old != NULL)
+              {
+                old->in_table = false;
+                by_key[key] = NULL;
+                cnt--;
+                if (moving)
+                  moving_deletes[growing]++;
+              }
+          }
+        if (i % 4 == 0)
+          verify_ohash (&h, cnt);
+      }
+  verify_ohash (&h, cnt);
+
+  /* Deletions and replacements happened while the table was
+     both growing and shrinking. */
+  ASSERT (moving_deletes[0] > 0 && moving_deletes[1] > 0);
+  ASSERT (moving_replaces[0] > 0 && moving_replaces[1] > 0);
+
+  ohash_clear (&h, NULL);
+  memset (by_key, 0, sizeof by_key);
+  verify_ohash (&h, 0);
+  ohash_destroy (&h, NULL);
+}
+
+/* Waits for the start of a timer tick and returns it. */
+static int64_t
+start_tick (void)
+{
+  int64_t start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  return timer_ticks ();
+}
+
+/* Prints how long hash_bytes(), hash_string(), and FNV-1 take to
+   hash BENCH_BYTES as keys of various sizes. */
+static void
+bench_bytes (void)
+{
+  static const size_t sizes[] = {4, 14, 64, 512};
+  static char key[512];
+  size_t i;
+
+  memset (key, 'x', sizeof key);
+  printf ("Ticks to hash %d MB, by key size:\n", BENCH_BYTES / 1024 / 1024);
+  printf ("%-12s%8s%8s%8s\n", "size", "bytes", "string", "fnv");
+  for (i = 0; i < sizeof sizes / sizeof *sizes; i++)
+    {
+      size_t size = sizes[i];
+      size_t iterations = BENCH_BYTES / size;
+      volatile unsigned sink = 0;
+      int64_t bytes_ticks, string_ticks, fnv_ticks, start;
+      size_t j;
+
+      key[size - 1] = '\0';
+
+      start = start_tick ();
+      for (j = 0; j < iterations; j++)
+        sink += hash_bytes (key, size);
+      bytes_ticks = timer_elapsed (start);
+
+      start = start_tick ();
+      for (j = 0; j < iterations; j++)
+        sink += hash_string (key);
+      string_ticks = timer_elapsed (start);
+
+      start = start_tick ();
+      for (j = 0; j < iterations; j++)
+        sink += fnv_bytes (key, size);
+      fnv_ticks = timer_elapsed (start);
+
+      key[size - 1] = 'x';
+      printf ("%-12zu%8"PRId64"%8"PRId64"%8"PRId64"\n",
+              size, bytes_ticks, string_ticks, fnv_ticks);
+    }
+}
+
+/* Prints how long hash_int() and FNV-1 take to hash a million
+   integers. */
+static void
+bench_int (void)
+{
+  volatile unsigned sink = 0;
+  int64_t start, int_ticks, fnv_ticks;
+  int i;
+
+  start = start_tick ();
+  for (i = 0; i < 1000000; i++)
+    sink += hash_int (i);
+  int_ticks = timer_elapsed (start);
+
+  start = start_tick ();
+  for (i = 0; i < 1000000; i++)
+    sink += fnv_int (i);
+  fnv_ticks = timer_elapsed (start);
+
+  printf ("Ticks to hash 1M integers: hash_int %"PRId64", fnv %"PRId64"\n",
+          int_ticks, fnv_ticks);
+}
+
+/* Returns the size of the largest of BUCKET_CNT buckets when
+   KEY_CNT consecutive integers starting at FIRST are placed by
+   the low bits of HASH. */
+static int
+max_bucket (unsigned (*hash) (int), int first)
+{
+  static int buckets[BUCKET_CNT];
+  int max = 0;
+  int i;
+
+  memset (buckets, 0, sizeof buckets);
+  for (i = first; i < first + KEY_CNT; i++)
+    {
+      int *b = &buckets[hash (i) % BUCKET_CNT];
+      if (++*b > max)
+        max = *b;
+    }
+  return max;
+}
+
+/* Checks that hash_int() spreads runs of consecutive integers,
+   like sector numbers, evenly, and prints how FNV-1 compares. */
+static void
+check_spread (void)
+{
+  int first;
+
+  printf ("Largest of %d buckets for %d consecutive keys (ideal %d):\n",
+          BUCKET_CNT, KEY_CNT, KEY_CNT / BUCKET_CNT);
+  for (first = 0; first <= 1 << 20; first += 1 << 18)
+    {
+      int int_max = max_bucket (hash_int, first);
+      int fnv_max = max_bucket (fnv_int, first);
+
+      printf ("  from %7d: hash_int %d, fnv %d\n", first, int_max, fnv_max);
+      ASSERT (int_max <= KEY_CNT / BUCKET_CNT * 3);
+    }
+}
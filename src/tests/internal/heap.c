@@ -0,0 +1,196 @@
+/* Test program for lib/kernel/heap.c.
+
+   Pushes, pops, removes, and reorders elements at random,
+   checking after each step that the heap is a complete binary
+   tree in heap order, and that elements come out least first,
+   with equal elements in the order they went in.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <heap.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Number of elements to test with. */
+#define ELEM_CNT 128
+
+/* Keys are drawn from 0...KEY_CNT - 1, so some repeat. */
+#define KEY_CNT 32
+
+/* A heap element. */
+struct value
+  {
+    struct heap_elem elem;      /* Heap element. */
+    int key;                    /* Sort key. */
+    int order;                  /* Sequence in which it was pushed. */
+    bool in_heap;               /* Currently in the heap? */
+  };
+
+static struct value values[ELEM_CNT];
+
+static bool value_less (const struct heap_elem *, const struct heap_elem *,
+                        void *);
+static size_t verify_subtree (struct heap_elem *, struct heap_elem *parent,
+                              int depth, int max_depth, int *leaf_depth);
+static void verify_heap (struct heap *, size_t cnt);
+static void drain_heap (struct heap *, size_t cnt);
+
+/* Tests the binary heap implementation. */
+void
+test (void)
+{
+  struct heap heap;
+  size_t cnt = 0;
+  int order = 0;
+  int i;
+
+  heap_init (&heap, value_less, NULL);
+  ASSERT (heap_empty (&heap) && heap_min (&heap) == NULL);
+
+  /* Change the heap at random, many times over. */
+  for (i = 0; i < ELEM_CNT * 64; i++)
+    {
+      struct value *v = &values[random_ulong () % ELEM_CNT];
+
+      if (!v->in_heap)
+        {
+          v->key = random_ulong () % KEY_CNT;
+          v->order = order++;
+          v->in_heap = true;
+          heap_push (&heap, &v->elem);
+          cnt++;
+        }
+      else
+        switch (random_ulong () % 4)
+          {
+          case 0:
+            v = heap_entry (heap_pop (&heap), struct value, elem);
+            v->in_heap = false;
+            cnt--;
+            break;
+
+          case 1:
+            heap_remove (&heap, &v->elem);
+            v->in_heap = false;
+            cnt--;
+            break;
+
+          case 2:
+            if (v->key > 0)
+              {
+                v->key -= random_ulong () % v->key + 1;
+                heap_decrease_key (&heap, &v->elem);
+              }
+            break;
+
+          case 3:
+            if (v->key < KEY_CNT - 1)
+              {
+                v->key += random_ulong () % (KEY_CNT - 1 - v->key) + 1;
+                heap_increase_key (&heap, &v->elem);
+              }
+            break;
+          }
+
+      verify_heap (&heap, cnt);
+    }
+
+  /* Everything left must come out in order. */
+  drain_heap (&heap, cnt);
+  ASSERT (heap_empty (&heap));
+
+  /* Equal keys come out in the order they went in. */
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      values[i].key = i % 2;
+      values[i].order = i;
+      heap_push (&heap, &values[i].elem);
+    }
+  drain_heap (&heap, ELEM_CNT);
+
+  printf ("heap: PASS\n");
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct heap_elem *a_, const struct heap_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = heap_entry (a_, struct value, elem);
+  const struct value *b = heap_entry (b_, struct value, elem);
+
+  return a->key < b->key;
+}
+
+/* Checks the subtree rooted at E, at DEPTH, whose parent should
+   be PARENT, and returns the number of elements in it.  Checks
+   that no element is less than its parent, and that the null
+   children, from left to right, are at MAX_DEPTH and then at
+   MAX_DEPTH - 1, as in a complete binary tree.  *LEAF_DEPTH is
+   the depth of the last null child seen. */
+static size_t
+verify_subtree (struct heap_elem *e, struct heap_elem *parent, int depth,
+                int max_depth, int *leaf_depth)
+{
+  if (e == NULL)
+    {
+      ASSERT (depth <= *leaf_depth && depth >= max_depth - 1);
+      *leaf_depth = depth;
+      return 0;
+    }
+
+  ASSERT (e->parent == parent);
+  ASSERT (parent == NULL || !value_less (e, parent, NULL));
+  return (1 + verify_subtree (e->left, e, depth + 1, max_depth, leaf_depth)
+          + verify_subtree (e->right, e, depth + 1, max_depth, leaf_depth));
+}
+
+/* Checks that HEAP holds CNT elements in heap order, with its
+   least element at the root. */
+static void
+verify_heap (struct heap *heap, size_t cnt)
+{
+  int max_depth = 0, leaf_depth;
+  size_t n;
+  int i;
+
+  /* The deepest null children are one level below the last
+     element. */
+  for (n = cnt; n > 0; n /= 2)
+    max_depth++;
+  leaf_depth = max_depth;
+  ASSERT (verify_subtree (heap->root, NULL, 0, max_depth, &leaf_depth)
+          == cnt);
+  ASSERT (heap_size (heap) == cnt);
+  ASSERT (heap_empty (heap) == (cnt == 0));
+
+  for (i = 0; i < ELEM_CNT; i++)
+    ASSERT (!values[i].in_heap
+            || (heap_entry (heap_min (heap), struct value, elem)->key
+                <= values[i].key));
+}
+
+/* Pops the CNT elements in HEAP, checking that they come out in
+   order of key, and of pushing among equal keys. */
+static void
+drain_heap (struct heap *heap, size_t cnt)
+{
+  struct value *prev = NULL;
+
+  for (; cnt > 0; cnt--)
+    {
+      struct value *v = heap_entry (heap_pop (heap), struct value, elem);
+
+      ASSERT (prev == NULL || prev->key < v->key
+              || (prev->key == v->key && prev->order < v->order));
+      v->in_heap = false;
+      prev = v;
+      verify_heap (heap, cnt - 1);
+    }
+}
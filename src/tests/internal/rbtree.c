@@ -0,0 +1,220 @@
+/* Test program for lib/kernel/rbtree.c.
+
+   Inserts and removes elements in random order, checking after
+   each step that the tree keeps the red-black properties and
+   its elements in order, and that searches and range iteration
+   find the elements they should.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <rbtree.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Number of elements to test with. */
+#define ELEM_CNT 256
+
+/* Keys are drawn from 0...KEY_CNT - 1, so some repeat. */
+#define KEY_CNT 64
+
+/* A tree element. */
+struct value
+  {
+    struct rb_elem elem;        /* Tree element. */
+    int key;                    /* Sort key. */
+    int id;                     /* Position in VALUES. */
+    bool in_tree;               /* Currently in the tree? */
+  };
+
+static struct value values[ELEM_CNT];
+
+static bool value_less (const struct rb_elem *, const struct rb_elem *,
+                        void *);
+static int verify_subtree (struct rb_elem *, struct rb_elem *parent,
+                           size_t *cnt);
+static void verify_tree (struct rb_tree *, size_t cnt);
+static void verify_search (struct rb_tree *, int key);
+
+/* Tests the red-black tree implementation. */
+void
+test (void)
+{
+  struct rb_tree tree;
+  struct rb_elem *e;
+  size_t cnt = 0;
+  int last_id[KEY_CNT];
+  int i, key;
+
+  rb_init (&tree, value_less, NULL);
+  for (i = 0; i < ELEM_CNT; i++)
+    values[i].id = i;
+
+  /* Insert or remove a random element, many times over. */
+  for (i = 0; i < ELEM_CNT * 64; i++)
+    {
+      struct value *v = &values[random_ulong () % ELEM_CNT];
+
+      if (!v->in_tree)
+        {
+          v->key = random_ulong () % KEY_CNT;
+          rb_insert (&tree, &v->elem);
+          cnt++;
+        }
+      else
+        {
+          rb_remove (&tree, &v->elem);
+          cnt--;
+        }
+      v->in_tree = !v->in_tree;
+
+      verify_tree (&tree, cnt);
+      if (i % ELEM_CNT == 0)
+        for (key = -1; key <= KEY_CNT; key++)
+          verify_search (&tree, key);
+    }
+
+  /* Empty the tree, then insert every element in order, so that
+     equal elements keep the order they were inserted in. */
+  for (i = 0; i < ELEM_CNT; i++)
+    if (values[i].in_tree)
+      rb_remove (&tree, &values[i].elem);
+  ASSERT (rb_empty (&tree));
+  for (i = 0; i < ELEM_CNT; i++)
+    {
+      values[i].key = i % KEY_CNT;
+      values[i].in_tree = true;
+      rb_insert (&tree, &values[i].elem);
+    }
+  verify_tree (&tree, ELEM_CNT);
+  for (key = 0; key < KEY_CNT; key++)
+    last_id[key] = -1;
+  for (e = rb_begin (&tree); e != rb_end (&tree); e = rb_next (e))
+    {
+      struct value *v = rb_entry (e, struct value, elem);
+      ASSERT (v->id > last_id[v->key]);
+      last_id[v->key] = v->id;
+    }
+
+  printf ("rbtree: PASS\n");
+}
+
+/* Returns true if value A is less than value B, false
+   otherwise. */
+static bool
+value_less (const struct rb_elem *a_, const struct rb_elem *b_,
+            void *aux UNUSED)
+{
+  const struct value *a = rb_entry (a_, struct value, elem);
+  const struct value *b = rb_entry (b_, struct value, elem);
+
+  return a->key < b->key;
+}
+
+/* Checks the subtree rooted at E, whose parent should be PARENT,
+   and adds its number of elements to *CNT.  Returns the number of
+   black elements on each path from E down to a leaf. */
+static int
+verify_subtree (struct rb_elem *e, struct rb_elem *parent, size_t *cnt)
+{
+  int left, right;
+
+  if (e == NULL)
+    return 1;
+
+  ASSERT (e->parent == parent);
+  ASSERT (!e->red || ((e->left == NULL || !e->left->red)
+                      && (e->right == NULL || !e->right->red)));
+  ASSERT (e->left == NULL || !value_less (e, e->left, NULL));
+  ASSERT (e->right == NULL || !value_less (e->right, e, NULL));
+
+  left = verify_subtree (e->left, e, cnt);
+  right = verify_subtree (e->right, e, cnt);
+  ASSERT (left == right);
+  ++*cnt;
+  return left + !e->red;
+}
+
+/* Checks that TREE is a valid red-black tree with CNT elements,
+   in order both forward and backward. */
+static void
+verify_tree (struct rb_tree *tree, size_t cnt)
+{
+  struct rb_elem *e;
+  size_t found = 0;
+  int key;
+
+  ASSERT (tree->root == NULL || !tree->root->red);
+  verify_subtree (tree->root, NULL, &found);
+  ASSERT (found == cnt);
+  ASSERT (rb_size (tree) == cnt);
+  ASSERT (rb_empty (tree) == (cnt == 0));
+
+  found = 0;
+  key = -1;
+  for (e = rb_begin (tree); e != rb_end (tree); e = rb_next (e))
+    {
+      struct value *v = rb_entry (e, struct value, elem);
+      ASSERT (v->in_tree && v->key >= key);
+      key = v->key;
+      found++;
+    }
+  ASSERT (found == cnt);
+
+  found = 0;
+  key = KEY_CNT;
+  for (e = rb_rbegin (tree); e != rb_rend (tree); e = rb_prev (e))
+    {
+      struct value *v = rb_entry (e, struct value, elem);
+      ASSERT (v->key <= key);
+      key = v->key;
+      found++;
+    }
+  ASSERT (found == cnt);
+}
+
+/* Checks rb_find(), rb_lower_bound(), and rb_upper_bound() for
+   KEY in TREE against a search of every value. */
+static void
+verify_search (struct rb_tree *tree, int key)
+{
+  struct value probe;
+  struct rb_elem *lower, *upper, *e;
+  int want_lower = KEY_CNT, want_upper = KEY_CNT;
+  int equal_cnt = 0;
+  int i;
+
+  for (i = 0; i < ELEM_CNT; i++)
+    if (values[i].in_tree)
+      {
+        int k = values[i].key;
+        if (k >= key && k < want_lower)
+          want_lower = k;
+        if (k > key && k < want_upper)
+          want_upper = k;
+        if (k == key)
+          equal_cnt++;
+      }
+
+  probe.key = key;
+  lower = rb_lower_bound (tree, &probe.elem);
+  upper = rb_upper_bound (tree, &probe.elem);
+  ASSERT (lower != NULL
+          ? rb_entry (lower, struct value, elem)->key == want_lower
+          : want_lower == KEY_CNT);
+  ASSERT (upper != NULL
+          ? rb_entry (upper, struct value, elem)->key == want_upper
+          : want_upper == KEY_CNT);
+  ASSERT (rb_find (tree, &probe.elem) == (equal_cnt > 0 ? lower : NULL));
+
+  for (e = lower; e != upper; e = rb_next (e))
+    {
+      ASSERT (rb_entry (e, struct value, elem)->key == key);
+      equal_cnt--;
+    }
+  ASSERT (equal_cnt == 0);
+}
@@ -0,0 +1,213 @@
+/* Test program and microbenchmark for the block memory
+   functions in lib/string.c.
+
+   Checks memcpy(), memmove(), memset(), and memcmp() against
+   simple byte-at-a-time versions for every size up to 64 bytes
+   at every alignment, then times each of them, and the byte
+   versions for comparison, on blocks of 16 bytes to 4 kB.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/palloc.h"
+#include "threads/test.h"
+#include "threads/vaddr.h"
+
+/* Largest size checked at every alignment. */
+#define CHECK_MAX 64
+
+/* Bytes moved for each size in the benchmark. */
+#define BENCH_BYTES (16 * 1024 * 1024)
+
+static void check (uint8_t *a, uint8_t *b, uint8_t *c);
+static void bench (uint8_t *a, uint8_t *b);
+
+void
+test (void)
+{
+  uint8_t *a = palloc_get_page (PAL_ASSERT);
+  uint8_t *b = palloc_get_page (PAL_ASSERT);
+  uint8_t *c = palloc_get_page (PAL_ASSERT);
+
+  check (a, b, c);
+  printf ("string: PASS\n");
+  bench (a, b);
+
+  palloc_free_page (c);
+  palloc_free_page (b);
+  palloc_free_page (a);
+}
+
+/* Byte-at-a-time memmove(), the reference for the copies. */
+static void
+byte_move (uint8_t *dst, const uint8_t *src, size_t size)
+{
+  if (dst < src)
+    while (size-- > 0)
+      *dst++ = *src++;
+  else
+    while (size-- > 0)
+      dst[size] = src[size];
+}
+
+/* Byte-at-a-time memset(). */
+static void
+byte_set (uint8_t *dst, int value, size_t size)
+{
+  while (size-- > 0)
+    *dst++ = value;
+}
+
+/* Byte-at-a-time memcmp(). */
+static int
+byte_cmp (const uint8_t *a, const uint8_t *b, size_t size)
+{
+  for (; size-- > 0; a++, b++)
+    if (*a != *b)
+      return *a > *b ? +1 : -1;
+  return 0;
+}
+
+/* Returns -1, 0, or +1 according to the sign of X. */
+static int
+sign (int x)
+{
+  return x < 0 ? -1 : x > 0;
+}
+
+/* Fills the page at P with random bytes. */
+static void
+randomize (uint8_t *p)
+{
+  random_bytes (p, PGSIZE);
+}
+
+/* Checks each function at every size up to CHECK_MAX and every
+   source and destination alignment, using pages A, B, and C. */
+static void
+check (uint8_t *a, uint8_t *b, uint8_t *c)
+{
+  size_t size, src_ofs, dst_ofs;
+
+  for (size = 0; size <= CHECK_MAX; size++)
+    for (src_ofs = 0; src_ofs < 8; src_ofs++)
+      for (dst_ofs = 0; dst_ofs < 8; dst_ofs++)
+        {
+          size_t i;
+
+          /* memcpy() between pages. */
+          randomize (a);
+          randomize (b);
+          memcpy (c, b, PGSIZE);
+          ASSERT (memcpy (b + dst_ofs, a + src_ofs, size) == b + dst_ofs);
+          byte_move (c + dst_ofs, a + src_ofs, size);
+          ASSERT (byte_cmp (b, c, PGSIZE) == 0);
+
+          /* memmove() within a page, in both directions. */
+          memcpy (c, b, PGSIZE);
+          ASSERT (memmove (b + dst_ofs, b + src_ofs, size) == b + dst_ofs);
+          byte_move (c + dst_ofs, c + src_ofs, size);
+          ASSERT (byte_cmp (b, c, PGSIZE) == 0);
+
+          /* memset(). */
+          ASSERT (memset (b + dst_ofs, src_ofs * 37, size) == b + dst_ofs);
+          byte_set (c + dst_ofs, src_ofs * 37, size);
+          ASSERT (byte_cmp (b, c, PGSIZE) == 0);
+
+          /* memcmp(), on equal blocks and with each byte changed. */
+          memcpy (b + dst_ofs, a + src_ofs, size);
+          ASSERT (memcmp (a + src_ofs, b + dst_ofs, size) == 0);
+          for (i = 0; i < size; i++)
+            {
+              b[dst_ofs + i] ^= 1 << (i % 8);
+              ASSERT (sign (memcmp (a + src_ofs, b + dst_ofs, size))
+                      == byte_cmp (a + src_ofs, b + dst_ofs, size));
+              b[dst_ofs + i] ^= 1 << (i % 8);
+            }
+        }
+}
+
+/* Functions timed by bench(). */
+enum bench_func
+  {
+    MEMCPY, BYTE_CPY,
+    MEMMOVE, BYTE_MOVE,
+    MEMSET, BYTE_SET,
+    MEMCMP, BYTE_CMP,
+    FUNC_CNT
+  };
+
+static const char *func_names[FUNC_CNT] =
+  {
+    "memcpy", "(bytes)", "memmove", "(bytes)",
+    "memset", "(bytes)", "memcmp", "(bytes)",
+  };
+
+/* Returns the number of timer ticks taken to run FUNC on blocks
+   of SIZE bytes in pages A and B, moving BENCH_BYTES in all. */
+static int64_t
+time_func (enum bench_func func, uint8_t *a, uint8_t *b, size_t size)
+{
+  size_t iterations = BENCH_BYTES / size;
+  int64_t start;
+  size_t i;
+
+  /* Start at the beginning of a tick. */
+  start = timer_ticks ();
+  while (timer_ticks () == start)
+    continue;
+  start = timer_ticks ();
+
+  for (i = 0; i < iterations; i++)
+    switch (func)
+      {
+      case MEMCPY: memcpy (b, a, size); break;
+      case BYTE_CPY: byte_move (b, a, size); break;
+      case MEMMOVE: memmove (a + 1, a, size); break;
+      case BYTE_MOVE: byte_move (a + 1, a, size); break;
+      case MEMSET: memset (b, i, size); break;
+      case BYTE_SET: byte_set (b, i, size); break;
+      case MEMCMP: ASSERT (memcmp (a, b, size) == 0); break;
+      case BYTE_CMP: ASSERT (byte_cmp (a, b, size) == 0); break;
+      default: NOT_REACHED ();
+      }
+  return timer_elapsed (start);
+}
+
+/* Prints how long each function takes to process BENCH_BYTES
+   in blocks of 16 bytes through 4 kB. */
+static void
+bench (uint8_t *a, uint8_t *b)
+{
+  size_t size;
+  int func;
+
+  printf ("Ticks to process %d MB, by block size:\n",
+          BENCH_BYTES / 1024 / 1024);
+  printf ("%-8s", "");
+  for (size = 16; size <= PGSIZE; size *= 4)
+    printf ("%8zu", size);
+  printf ("\n");
+
+  for (func = 0; func < FUNC_CNT; func++)
+    {
+      printf ("%-8s", func_names[func]);
+      for (size = 16; size <= PGSIZE; size *= 4)
+        {
+          /* memmove() shifts up by one byte, so leave room. */
+          size_t len = size < PGSIZE ? size : PGSIZE - 1;
+
+          memcpy (b, a, PGSIZE);
+          printf ("%8"PRId64, time_func (func, a, b, len));
+        }
+      printf ("\n");
+    }
+}
@@ -0,0 +1,107 @@
+/* Allocates and frees blocks of many sizes, small and large,
+   in random order, checking that no block overwrites another,
+   then checks calloc() and realloc(), and that freeing large
+   blocks gives memory back to the heap. */
+
+#include <random.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* Number of blocks allocated at once. */
+#define BLOCK_CNT 64
+
+struct allocation
+  {
+    unsigned char *p;           /* Block, or null. */
+    size_t size;                /* Requested size. */
+    unsigned char fill;         /* Byte the block is filled with. */
+  };
+
+static struct allocation blocks[BLOCK_CNT];
+
+/* Returns a random size, mostly small and sometimes large. */
+static size_t
+random_size (void)
+{
+  if (random_ulong () % 4 != 0)
+    return random_ulong () % 2000 + 1;
+  else
+    return random_ulong () % 20000 + 1;
+}
+
+/* Fails unless block B still holds its fill byte. */
+static void
+check_block (const struct allocation *b)
+{
+  size_t i;
+
+  for (i = 0; i < b->size; i++)
+    if (b->p[i] != b->fill)
+      fail ("byte %zu of %zu-byte block is %02x, not %02x",
+            i, b->size, b->p[i], b->fill);
+}
+
+void
+test_main (void) 
+{
+  unsigned char *p;
+  char *top;
+  size_t i;
+  int round;
+
+  random_init (0);
+  for (round = 0; round < 2000; round++)
+    {
+      struct allocation *b = &blocks[random_ulong () % BLOCK_CNT];
+
+      if (b->p != NULL)
+        {
+          check_block (b);
+          free (b->p);
+          b->p = NULL;
+        }
+      else
+        {
+          b->size = random_size ();
+          b->fill = random_ulong ();
+          b->p = malloc (b->size);
+          if (b->p == NULL)
+            fail ("malloc (%zu) failed", b->size);
+          memset (b->p, b->fill, b->size);
+        }
+    }
+  for (i = 0; i < BLOCK_CNT; i++)
+    if (blocks[i].p != NULL)
+      {
+        check_block (&blocks[i]);
+        free (blocks[i].p);
+      }
+  msg ("random allocations kept their contents");
+
+  p = calloc (1000, 4);
+  CHECK (p != NULL, "calloc (1000, 4)");
+  for (i = 0; i < 4000; i++)
+    if (p[i] != 0)
+      fail ("byte %zu of calloc'd block is %d, not zero", i, p[i]);
+
+  for (i = 0; i < 4000; i++)
+    p[i] = i;
+  p = realloc (p, 40000);
+  CHECK (p != NULL, "realloc (p, 40000)");
+  for (i = 0; i < 4000; i++)
+    if (p[i] != (unsigned char) i)
+      fail ("byte %zu of realloc'd block is %d, not %d",
+            i, p[i], (unsigned char) i);
+  free (p);
+
+  top = sbrk (0);
+  p = malloc (1024 * 1024);
+  CHECK (p != NULL, "malloc (1048576)");
+  memset (p, 0xcc, 1024 * 1024);
+  free (p);
+  CHECK ((char *) sbrk (0) <= top, "free gives memory back to the heap");
+}
@@ -0,0 +1,15 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(malloc) begin
+(malloc) random allocations kept their contents
+(malloc) calloc (1000, 4)
+(malloc) realloc (p, 40000)
+(malloc) malloc (1048576)
+(malloc) free gives memory back to the heap
+(malloc) end
+malloc: exit(0)
+EOF
+pass;
@@ -0,0 +1,40 @@
+/* Grows the heap with sbrk(), checks that the new memory is
+   zeroed and writable, and shrinks it again.  Also checks that
+   sbrk() refuses to move the heap below its start or past the
+   memory available, and leaves it unchanged when it does. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+/* A little over three pages. */
+#define SIZE (3 * 4096 + 100)
+
+void
+test_main (void) 
+{
+  char *start = sbrk (0);
+  size_t i;
+
+  CHECK (start != (void *) -1, "sbrk (0)");
+  CHECK (sbrk (SIZE) == start, "sbrk (%d)", SIZE);
+  CHECK (sbrk (0) == start + SIZE, "heap end moved by %d", SIZE);
+
+  for (i = 0; i < SIZE; i++)
+    if (start[i] != 0)
+      fail ("byte %zu of new heap is %d, not zero", i, start[i]);
+  memset (start, 0x5a, SIZE);
+  msg ("new heap is zeroed and writable");
+
+  CHECK (sbrk (-SIZE) == start + SIZE, "sbrk (-%d)", SIZE);
+  CHECK (sbrk (-1) == (void *) -1, "sbrk (-1) below heap start fails");
+  CHECK (sbrk (0x40000000) == (void *) -1, "sbrk (0x40000000) fails");
+  CHECK (sbrk (0) == start, "heap end unchanged");
+
+  CHECK (sbrk (SIZE) == start, "sbrk (%d) again", SIZE);
+  for (i = 0; i < SIZE; i++)
+    if (start[i] != 0)
+      fail ("byte %zu of regrown heap is %d, not zero", i, start[i]);
+  msg ("regrown heap is zeroed");
+}
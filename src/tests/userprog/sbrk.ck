@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(sbrk) begin
+(sbrk) sbrk (0)
+(sbrk) sbrk (12388)
+(sbrk) heap end moved by 12388
+(sbrk) new heap is zeroed and writable
+(sbrk) sbrk (-12388)
+(sbrk) sbrk (-1) below heap start fails
+(sbrk) sbrk (0x40000000) fails
+(sbrk) heap end unchanged
+(sbrk) sbrk (12388) again
+(sbrk) regrown heap is zeroed
+(sbrk) end
+sbrk: exit(0)
+EOF
+pass;
@@ -34,6 +34,7 @@
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
+#include "devices/ramdisk.h"
 #include "filesys/filesys.h"
 #include "filesys/fsutil.h"
 #endif
@@ -52,8 +53,17 @@ static const char *scratch_bdev_name;
 #ifdef VM
 static const char *swap_bdev_name;
 #endif
+
+/* -blktrace: Number of block requests to keep in the trace. */
+static size_t blktrace_size;
+
+/* -ramdisk: Size of RAM disk in kB, or 0 for none. */
+static size_t ramdisk_size;
 #endif /* FILESYS */
 
+/* -inbuf: Size of the keyboard and serial input buffer, in bytes. */
+static size_t input_size = 1024;
+
 /* -ul: Maximum number of pages to put into palloc's user pool. */
 static size_t user_page_limit = SIZE_MAX;
 
@@ -109,7 +119,7 @@ main (void)
   intr_init ();
   timer_init ();
   kbd_init ();
-  input_init ();
+  input_init (input_size);
 #ifdef USERPROG
   exception_init ();
   syscall_init ();
@@ -122,7 +132,10 @@ main (void)
 
 #ifdef FILESYS
   /* Initialize file system. */
+  if (blktrace_size > 0)
+    block_trace_init (blktrace_size);
   ide_init ();
+  ramdisk_init (ramdisk_size);
   locate_block_devices ();
   filesys_init (format_filesys);
 #endif
@@ -247,11 +260,17 @@ parse_options (char **argv)
         filesys_bdev_name = value;
       else if (!strcmp (name, "-scratch"))
         scratch_bdev_name = value;
+      else if (!strcmp (name, "-blktrace"))
+        blktrace_size = atoi (value);
+      else if (!strcmp (name, "-ramdisk"))
+        ramdisk_size = atoi (value);
 #ifdef VM
       else if (!strcmp (name, "-swap"))
         swap_bdev_name = value;
 #endif
 #endif
+      else if (!strcmp (name, "-inbuf"))
+        input_size = atoi (value);
       else if (!strcmp (name, "-rs"))
         random_init (atoi (value));
       else if (!strcmp (name, "-mlfqs"))
@@ -292,6 +311,18 @@ run_task (char **argv)
   printf ("Execution of '%s' complete.\n", task);
 }
 
+#ifdef FILESYS
+/* Writes the block request trace to the scratch device. */
+static void
+dump_block_trace (char **argv UNUSED)
+{
+  struct block *scratch = block_get_role (BLOCK_SCRATCH);
+  if (scratch == NULL)
+    PANIC ("couldn't open scratch device");
+  block_trace_dump (scratch);
+}
+#endif
+
 /* Executes all of the actions specified in ARGV[]
    up to the null pointer sentinel. */
 static void
@@ -315,6 +346,9 @@ run_actions (char **argv)
       {"rm", 2, fsutil_rm},
       {"extract", 1, fsutil_extract},
       {"append", 2, fsutil_append},
+      {"frag", 1, fsutil_frag},
+      {"defrag", 1, fsutil_defrag},
+      {"blktrace", 1, dump_block_trace},
 #endif
       {NULL, 0, NULL},
     };
@@ -361,6 +395,9 @@ usage (void)
           "  ls                 List files in the root directory.\n"
           "  cat FILE           Print FILE to the console.\n"
           "  rm FILE            Delete FILE.\n"
+          "  frag               Report each file's fragment count.\n"
+          "  defrag             Make each file's data contiguous.\n"
+          "  blktrace           Write block request trace to scratch device.\n"
           "Use these actions indirectly via `pintos' -g and -p options:\n"
           "  extract            Untar from scratch device into file system.\n"
           "  append FILE        Append FILE to tar file on scratch device.\n"
@@ -373,10 +410,13 @@ usage (void)
           "  -f                 Format file system device during startup.\n"
           "  -filesys=BDEV      Use BDEV for file system instead of default.\n"
           "  -scratch=BDEV      Use BDEV for scratch instead of default.\n"
+          "  -blktrace=COUNT    Trace the last COUNT block requests.\n"
+          "  -ramdisk=KB        Create KB kB RAM disk ram0 (e.g. -filesys=ram0).\n"
 #ifdef VM
           "  -swap=BDEV         Use BDEV for swap instead of default.\n"
 #endif
 #endif
+          "  -inbuf=BYTES       Buffer up to BYTES bytes of keyboard input.\n"
           "  -rs=SEED           Set random number seed to SEED.\n"
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
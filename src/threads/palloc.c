@@ -89,7 +89,12 @@ palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   if (pages != NULL) 
     {
       if (flags & PAL_ZERO)
-        memset (pages, 0, PGSIZE * page_cnt);
+        {
+          size_t i;
+
+          for (i = 0; i < page_cnt; i++)
+            page_zero ((uint8_t *) pages + PGSIZE * i);
+        }
     }
   else 
     {
@@ -148,6 +153,33 @@ palloc_free_page (void *page)
   palloc_free_multiple (page, 1);
 }
 
+/* Fills the page at PAGE with zeros.
+   Faster than memset() because the size and alignment are known
+   in advance, so it is a single string instruction. */
+void
+page_zero (void *page)
+{
+  size_t cnt = PGSIZE / sizeof (uint32_t);
+
+  ASSERT (pg_ofs (page) == 0);
+  asm volatile ("rep stosl"
+                : "+D" (page), "+c" (cnt) : "a" (0) : "memory");
+}
+
+/* Copies the page at SRC to the page at DST, which must not
+   overlap.  Faster than memcpy() for the same reason as
+   page_zero(). */
+void
+page_copy (void *dst, const void *src)
+{
+  size_t cnt = PGSIZE / sizeof (uint32_t);
+
+  ASSERT (pg_ofs (dst) == 0);
+  ASSERT (pg_ofs (src) == 0);
+  asm volatile ("rep movsl"
+                : "+D" (dst), "+S" (src), "+c" (cnt) : : "memory");
+}
+
 /* Initializes pool P as starting at START and ending at END,
    naming it NAME for debugging purposes. */
 static void
@@ -17,4 +17,7 @@ void *palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
 
+void page_zero (void *);
+void page_copy (void *dst, const void *src);
+
 #endif /* threads/palloc.h */
@@ -106,6 +106,8 @@ struct thread
 #ifdef USERPROG
     /* Owned by userprog/process.c. */
     uint32_t *pagedir;                  /* Page directory. */
+    uint8_t *heap_start;                /* Start of heap, after data. */
+    uint8_t *heap_end;                  /* End of heap, set by sbrk(). */
     struct thread *parent;		/* Parent process. */
     struct list children;		/* List of child process */ 
     struct file *file;			/* File pointer */
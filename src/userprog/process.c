@@ -23,6 +23,8 @@
 
 static thread_func start_process NO_RETURN;
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
+static bool install_page (void *upage, void *kpage, bool writable);
+static void unmap_pages (uint8_t *start, uint8_t *end);
 void return_exit (struct thread *t, int tid, int status);
 int get_exit (struct thread *t, tid_t tid);
 struct child* get_child (struct thread *t, tid_t tid);
@@ -280,6 +282,64 @@ process_activate (void)
   tss_update ();
 }
 
+/* Moves the end of the current process's heap by INCREMENT
+   bytes, which may be negative, and returns its old end, or
+   (void *) -1 if the heap cannot be moved that far.  Growing
+   the heap maps zeroed pages; shrinking it unmaps and frees
+   pages that no longer hold any of it.  The heap may not grow
+   into the page below PHYS_BASE that holds the stack. */
+void *
+process_sbrk (intptr_t increment)
+{
+  struct thread *t = thread_current ();
+  uint8_t *old_end = t->heap_end;
+  uint8_t *new_end;
+  uint8_t *upage;
+
+  if (t->heap_start == NULL)
+    return (void *) -1;
+  if (increment >= 0
+      ? (size_t) increment > (size_t) ((uint8_t *) PHYS_BASE - PGSIZE
+                                       - old_end)
+      : -(size_t) increment > (size_t) (old_end - t->heap_start))
+    return (void *) -1;
+  new_end = old_end + increment;
+
+  /* Map the pages that the heap grows into. */
+  for (upage = pg_round_up (old_end); upage < new_end; upage += PGSIZE)
+    {
+      uint8_t *kpage = palloc_get_page (PAL_USER | PAL_ZERO);
+      if (kpage == NULL || !install_page (upage, kpage, true))
+        {
+          palloc_free_page (kpage);
+          unmap_pages (pg_round_up (old_end), upage);
+          return (void *) -1;
+        }
+    }
+
+  /* Unmap the pages that the heap shrinks out of. */
+  unmap_pages (pg_round_up (new_end), pg_round_up (old_end));
+
+  t->heap_end = new_end;
+  return old_end;
+}
+
+/* Unmaps the current process's user pages from START up to
+   END, both page-aligned, and frees them. */
+static void
+unmap_pages (uint8_t *start, uint8_t *end)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  uint8_t *upage;
+
+  for (upage = start; upage < end; upage += PGSIZE)
+    {
+      void *kpage = pagedir_get_page (pd, upage);
+      pagedir_clear_page (pd, upage);
+      palloc_free_page (kpage);
+    }
+}
+
 /* We load ELF binaries.  The following definitions are taken
    from the ELF specification, [ELF1], more-or-less verbatim.  */
 
@@ -370,6 +430,7 @@ load (const char *file_name, void (**eip) (void), void **esp)
   if (t->pagedir == NULL) 
     goto done;
   process_activate ();
+  t->heap_start = NULL;
 
   /* Open executable file. */
   fn = malloc (strlen (file_name) + 1);
@@ -450,6 +511,13 @@ load (const char *file_name, void (**eip) (void), void **esp)
               if (!load_segment (file, file_page, (void *) mem_page,
                                  read_bytes, zero_bytes, writable))
                 goto done;
+
+              /* The heap starts at the page after the last
+                 segment. */
+              if ((uint8_t *) mem_page + read_bytes + zero_bytes
+                  > t->heap_start)
+                t->heap_start = ((uint8_t *) mem_page
+                                 + read_bytes + zero_bytes);
             }
           else
             goto done;
@@ -457,6 +525,8 @@ load (const char *file_name, void (**eip) (void), void **esp)
         }
     }
 
+  t->heap_end = t->heap_start;
+
   /* Set up working directory */
   if (thread_current ()->dir)
     t->dir = dir_reopen (thread_current ()->dir);
@@ -486,8 +556,6 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
 /* load() helpers. */
 
-static bool install_page (void *upage, void *kpage, bool writable);
-
 /* Checks whether PHDR describes a valid, loadable segment in
    FILE and returns true if so, false otherwise. */
 static bool
@@ -575,7 +643,10 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
           palloc_free_page (kpage);
           return false; 
         }
-      memset (kpage + page_read_bytes, 0, page_zero_bytes);
+      if (page_zero_bytes == PGSIZE)
+        page_zero (kpage);
+      else
+        memset (kpage + page_read_bytes, 0, page_zero_bytes);
 
       /* Add the page to the process's address space. */
       if (!install_page (upage, kpage, writable)) 
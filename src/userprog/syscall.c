@@ -2,6 +2,7 @@
 #include "userprog/process.h"
 #include "userprog/pagedir.h"
 #include <stdio.h>
+#include <string.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/synch.h"
@@ -14,6 +15,7 @@
 #include "filesys/directory.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/journal.h"
 
 struct child* get_child (struct thread *t, tid_t tid);
 static void syscall_handler (struct intr_frame *);
@@ -25,6 +27,7 @@ void get_arg (struct intr_frame *f, int *arg, int n);
 int ptr_user_to_kernel(const void *vaddr);
 void ptr_validate (const void *vaddr);
 void buf_validate (const void *buf, unsigned size);
+static void copy_to_user (void *udst, const void *src, size_t size);
 
 
 void syscall_init (void) 
@@ -177,6 +180,41 @@ static void syscall_handler (struct intr_frame *f UNUSED)
         f->eax = inumber(arg[0]);
         break;
       }
+    //bool rmtree (const char *dir)
+    case SYS_RMTREE:
+      {
+        get_arg(f, &arg[0], 1);
+        arg[0] = ptr_user_to_kernel((const void *) arg[0]);
+        f->eax = rmtree((const char *) arg[0]);
+        break;
+      }
+    //int readdir_plus (int fd, struct dirent_plus *entries, unsigned cnt)
+    case SYS_READDIR_PLUS:
+      {
+        get_arg(f, &arg[0], 3);
+        if (arg[2] == 0)
+          {
+            f->eax = 0;
+            break;
+          }
+        if ((unsigned) arg[2] > UINT32_MAX / sizeof (struct dirent_plus))
+          {
+            f->eax = SYSCALL_ERROR;
+            break;
+          }
+        buf_validate((const void *) arg[1],
+                     (unsigned) arg[2] * sizeof (struct dirent_plus));
+        f->eax = readdir_plus(arg[0], (struct dirent_plus *) arg[1],
+                              (unsigned) arg[2]);
+        break;
+      }
+    //void *sbrk (intptr_t increment)
+    case SYS_SBRK:
+      {
+        get_arg(f, &arg[0], 1);
+        f->eax = (uint32_t) sbrk((intptr_t) arg[0]);
+        break;
+      }
   }
 }
 
@@ -274,6 +312,14 @@ bool remove (const char *file)
   return success;
 }
 
+bool rmtree (const char *dir)
+{
+  lock_acquire(&fs_lock);
+  bool success = filesys_remove_tree(dir);
+  lock_release(&fs_lock);
+  return success;
+}
+
 int open (const char *file)
 { 
   lock_acquire(&fs_lock);
@@ -305,12 +351,10 @@ int read (int fd, void *buffer, unsigned length)
   if (fd == STDIN_FILENO) 
   {
     uint8_t *buf = (uint8_t *) buffer; // 1byte char array
-    unsigned i;
-    for (i = 0; i < length; i++) 
-    {
-      buf[i] = input_getc();
-      // buf size limit?
-    } 
+    unsigned i = 0;
+    // Take every key already typed on each wakeup.
+    while (i < length)
+      i += input_getbuf(buf + i, length - i);
     return length;
   }
   // From filesystem
@@ -402,10 +446,16 @@ mkdir (const char *dir)
   char *new_dir = get_filename (dir);
   struct inode *inode;
   block_sector_t sector = -1;
+  block_sector_t goal = 0;
+
+  /* Spread directories out over the allocation groups. */
+  if (cur_dir != NULL)
+    goal = free_map_dir_goal (inode_get_inumber (dir_get_inode (cur_dir)));
 
+  journal_begin ();
   bool success = (cur_dir != NULL
 		  && !dir_lookup (cur_dir, new_dir, &inode)
-		  && free_map_allocate (1, &sector)
+		  && free_map_allocate_near (1, goal, &sector)
 		  && dir_create (sector, 16, cur_dir)
 		  && dir_add (cur_dir, new_dir, sector));
 
@@ -414,6 +464,7 @@ mkdir (const char *dir)
   
   if(!success && sector != -1)
     free_map_release (sector, 1);
+  journal_end ();
 
   return success;
 }
@@ -448,6 +499,52 @@ readdir (int fd, char *name)
   return dir_readdir (pf->dir, name);
 }
 
+/* Reads up to CNT entries from directory FD into ENTRIES, along
+   with each entry's inode number, type and size, so that listing
+   a directory takes no open() per entry.  ENTRIES is a user
+   address whose CNT entries must already have been validated.
+   Returns the number of entries read, 0 at the end of the
+   directory, or -1 if FD is not an open directory. */
+int
+readdir_plus (int fd, struct dirent_plus *entries, unsigned cnt)
+{
+  struct thread *cur = thread_current ();
+  struct list_elem *e;
+  struct process_file *pf = NULL;
+  unsigned n;
+
+  for (e = list_begin (&cur->files); e != list_end (&cur->files); e = list_next (e))
+  {
+    struct process_file *p = list_entry (e, struct process_file, elem);
+    if (p->fd == fd)
+    {
+      pf = p;
+      break;
+    }
+  }
+
+  if (pf == NULL || pf->dir == NULL)
+    return SYSCALL_ERROR;
+
+  lock_acquire (&fs_lock);
+  for (n = 0; n < cnt; n++)
+  {
+    struct dirent_plus d;
+    struct inode *inode;
+
+    if (!dir_readdir_inode (pf->dir, d.name, &inode))
+      break;
+    d.isdir = inode != NULL && inode_is_dir (inode);
+    d.inumber = inode != NULL ? (int) inode_get_inumber (inode) : -1;
+    d.length = inode != NULL ? inode_length (inode) : 0;
+    inode_close (inode);
+    copy_to_user (&entries[n], &d, sizeof d);
+  }
+  lock_release (&fs_lock);
+
+  return n;
+}
+
 bool
 isdir (int fd)
 {
@@ -513,6 +610,11 @@ int wait (pid_t pid)
   return process_wait (pid);
 }
 
+void *sbrk (intptr_t increment)
+{
+  return process_sbrk (increment);
+}
+
 /* Operations for memory management and argument passing */
 
 /*
@@ -557,12 +659,44 @@ err:
   exit(SYSCALL_ERROR);
 }
 
-/* Prevents buffer overflow. 
- * Assume any buffer resides on memory continuously.
- * TODO : Is the assumption above safe?
+/* Prevents buffer overflow.
+ * Checks every page of the buffer, since user pages that are
+ * adjacent in virtual memory need not be mapped.
  */
 void buf_validate (const void *buf, unsigned size)
 {
+  const uint8_t *end = (const uint8_t *) buf + size - 1;
+  const uint8_t *page;
+
   ptr_validate(buf);
-  ptr_validate(buf+size-1);
+  if (size == 0)
+    return;
+  if (end < (const uint8_t *) buf)
+    exit(SYSCALL_ERROR);
+  for (page = (const uint8_t *) pg_round_down(buf) + PGSIZE; page <= end;
+       page += PGSIZE)
+    ptr_validate(page);
+  ptr_validate(end);
+}
+
+/* Copies SIZE bytes from kernel address SRC to user address
+ * UDST, which buf_validate() must already have accepted.  Goes
+ * a page at a time, because the kernel addresses of adjacent
+ * user pages need not be adjacent.
+ */
+static void copy_to_user (void *udst, const void *src, size_t size)
+{
+  uint8_t *dst = udst;
+  const uint8_t *s = src;
+
+  while (size > 0)
+    {
+      size_t chunk = PGSIZE - pg_ofs(dst);
+      if (chunk > size)
+        chunk = size;
+      memcpy(pagedir_get_page(thread_current()->pagedir, dst), s, chunk);
+      dst += chunk;
+      s += chunk;
+      size -= chunk;
+    }
 }
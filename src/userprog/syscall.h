@@ -2,6 +2,7 @@
 #define __LIB_USER_SYSCALL_H
 
 #include <stdbool.h>
+#include <stdint.h>
 #include <debug.h>
 #include "filesys/file.h"
 #include "filesys/directory.h"
@@ -23,6 +24,16 @@ typedef int mapid_t;
 /* Maximum characters in a filename written by readdir(). */
 #define READDIR_MAX_LEN 14
 
+/* A directory entry with its inode's metadata, as stored by
+   readdir_plus(). */
+struct dirent_plus
+  {
+    char name[READDIR_MAX_LEN + 1];     /* Null-terminated file name. */
+    bool isdir;                         /* Is it a directory? */
+    int inumber;                        /* Inode number. */
+    int length;                         /* Size in bytes. */
+  };
+
 /* Typical return values from main() and arguments to exit(). */
 #define EXIT_SUCCESS 0          /* Successful execution. */
 #define EXIT_FAILURE 1          /* Unsuccessful execution. */
@@ -48,6 +59,9 @@ bool mkdir (const char *dir);
 bool readdir (int fd, char *name);
 bool isdir (int fd);
 int inumber (int fd);
+bool rmtree (const char *dir);
+int readdir_plus (int fd, struct dirent_plus *entries, unsigned cnt);
+void *sbrk (intptr_t increment);
 
 /* Process file definitions */ 
 